@@ -1,13 +1,56 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+// IORING_OP_READ and the opcode probe arrived with 5.6 UAPI headers; older
+// headers leave the direct-I/O backend on pread threads
+#ifdef IO_URING_OP_SUPPORTED
+#define PIR_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
 #ifdef _WIN32
 #ifndef NOMINMAX
 #define NOMINMAX
@@ -15,6 +58,11 @@
 #include <windows.h>
 #endif
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PIR_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 namespace fs = std::filesystem;
 
 static std::string nowMs() {
@@ -32,324 +80,4183 @@ static void printDivider() {
     std::cout << std::string(50, '=') << "\n";
 }
 
-// Read full text file consisting of '0' and '1' chars into vector<int> bits
-static bool readBitsFile(const fs::path &path, std::vector<int> &outBits) {
-    std::ifstream in(path, std::ios::in | std::ios::binary);
-    if (!in.is_open()) return false;
-    std::string s;
-    in.seekg(0, std::ios::end);
-    s.resize(static_cast<size_t>(in.tellg()));
-    in.seekg(0, std::ios::beg);
-    in.read(&s[0], static_cast<std::streamsize>(s.size()));
-    outBits.reserve(s.size());
-    for (char c : s) {
-        if (c == '0') outBits.push_back(0);
-        else if (c == '1') outBits.push_back(1);
+// Packed bit buffer backed by 64-bit words. Bits are stored MSB-first within
+// each byte and bytes in memory order, so bytes() is exactly the packed video
+// and word-wise AND/XOR need no reshuffling. Bits past size() are kept zero.
+class BitVector {
+public:
+    BitVector() = default;
+    explicit BitVector(size_t bits) { resize(bits); }
+
+    size_t size() const { return bits_; }
+    bool empty() const { return bits_ == 0; }
+    size_t wordCount() const { return words_.size(); }
+    size_t byteSize() const { return (bits_ + 7) / 8; }
+
+    uint64_t *words() { return words_.data(); }
+    const uint64_t *words() const { return words_.data(); }
+    unsigned char *bytes() { return reinterpret_cast<unsigned char*>(words_.data()); }
+    const unsigned char *bytes() const { return reinterpret_cast<const unsigned char*>(words_.data()); }
+
+    bool get(size_t i) const { return (bytes()[i >> 3] >> (7 - (i & 7))) & 1; }
+    void set(size_t i, bool bit) {
+        const unsigned char mask = static_cast<unsigned char>(0x80u >> (i & 7));
+        if (bit) bytes()[i >> 3] |= mask;
+        else bytes()[i >> 3] &= static_cast<unsigned char>(~mask);
+    }
+    void push_back(bool bit) {
+        if (bits_ == words_.size() * 64) words_.push_back(0);
+        ++bits_;
+        set(bits_ - 1, bit);
+    }
+
+    void reserve(size_t bits) { words_.reserve((bits + 63) / 64); }
+    void resize(size_t bits) {
+        const size_t old = bits_;
+        words_.resize((bits + 63) / 64, 0);
+        bits_ = bits;
+        if (bits < old) clearTail();
+    }
+
+    // Zero the padding bits after size() in the last word
+    void clearTail() {
+        unsigned char *b = bytes();
+        const size_t used = byteSize();
+        if (bits_ % 8 != 0) b[used - 1] &= static_cast<unsigned char>(0xFFu << (8 - bits_ % 8));
+        std::memset(b + used, 0, words_.size() * 8 - used);
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t bits_ = 0;
+};
+
+// Word kernels for the server combine step: out = (a & ra) ^ (b & rb), which is
+// D0.r1 + D1.r2 over GF(2). The widest path the CPU supports is picked once at runtime.
+using CombineFn = void (*)(uint64_t *out, const uint64_t *a, const uint64_t *ra,
+                           const uint64_t *b, const uint64_t *rb, size_t n);
+
+static void combineWordsPortable(uint64_t *out, const uint64_t *a, const uint64_t *ra,
+                                 const uint64_t *b, const uint64_t *rb, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = (a[i] & ra[i]) ^ (b[i] & rb[i]);
+}
+
+#ifdef PIR_X86_DISPATCH
+__attribute__((target("avx2")))
+static void combineWordsAvx2(uint64_t *out, const uint64_t *a, const uint64_t *ra,
+                             const uint64_t *b, const uint64_t *rb, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i x = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ra + i)));
+        const __m256i y = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rb + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(x, y));
+    }
+    combineWordsPortable(out + i, a + i, ra + i, b + i, rb + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void combineWordsAvx512(uint64_t *out, const uint64_t *a, const uint64_t *ra,
+                               const uint64_t *b, const uint64_t *rb, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512i x = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(ra + i));
+        // 0x78 is the truth table of x ^ (y & z)
+        const __m512i r = _mm512_ternarylogic_epi64(x, _mm512_loadu_si512(b + i), _mm512_loadu_si512(rb + i), 0x78);
+        _mm512_storeu_si512(out + i, r);
+    }
+    combineWordsPortable(out + i, a + i, ra + i, b + i, rb + i, n - i);
+}
+#endif
+
+enum class SimdLevel { Portable, Avx2, Avx512 };
+
+static SimdLevel detectSimdLevel() {
+    static const SimdLevel level = [] {
+#ifdef PIR_X86_DISPATCH
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+#endif
+        return SimdLevel::Portable;
+    }();
+    return level;
+}
+
+static const char *simdLevelName() {
+    switch (detectSimdLevel()) {
+    case SimdLevel::Avx512: return "avx512";
+    case SimdLevel::Avx2: return "avx2";
+    default: return "portable";
+    }
+}
+
+static void combineMasked(uint64_t *out, const uint64_t *a, const uint64_t *ra,
+                          const uint64_t *b, const uint64_t *rb, size_t n) {
+    static const CombineFn fn = [] {
+#ifdef PIR_X86_DISPATCH
+        if (detectSimdLevel() == SimdLevel::Avx512) return &combineWordsAvx512;
+        if (detectSimdLevel() == SimdLevel::Avx2) return &combineWordsAvx2;
+#endif
+        return &combineWordsPortable;
+    }();
+    fn(out, a, ra, b, rb, n);
+}
+
+// acc ^= in over n words; the XOR PIR answer is a running XOR of selected records
+using XorFn = void (*)(uint64_t *acc, const uint64_t *in, size_t n);
+
+static void xorWordsPortable(uint64_t *acc, const uint64_t *in, size_t n) {
+    for (size_t i = 0; i < n; ++i) acc[i] ^= in[i];
+}
+
+#ifdef PIR_X86_DISPATCH
+__attribute__((target("avx2")))
+static void xorWordsAvx2(uint64_t *acc, const uint64_t *in, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), x);
+    }
+    xorWordsPortable(acc + i, in + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void xorWordsAvx512(uint64_t *acc, const uint64_t *in, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_si512(acc + i, _mm512_xor_si512(_mm512_loadu_si512(acc + i), _mm512_loadu_si512(in + i)));
+    }
+    xorWordsPortable(acc + i, in + i, n - i);
+}
+#endif
+
+static void xorInto(uint64_t *acc, const uint64_t *in, size_t n) {
+    static const XorFn fn = [] {
+#ifdef PIR_X86_DISPATCH
+        if (detectSimdLevel() == SimdLevel::Avx512) return &xorWordsAvx512;
+        if (detectSimdLevel() == SimdLevel::Avx2) return &xorWordsAvx2;
+#endif
+        return &xorWordsPortable;
+    }();
+    fn(acc, in, n);
+}
+
+// GF(2) product of a K x N selection bit-matrix with N database row slices:
+// acc[q] ^= XOR of rows[r] over every r that sel row q selects. sel holds K rows
+// of (nRows + 7) / 8 bytes (bit r % 8 of byte r / 8 is row r); acc holds K rows
+// accStride words apart; each row slice is n words.
+// Method of Four Russians: rows are taken g at a time and all 2^g XOR
+// combinations of those g rows are tabulated once, after which each query
+// costs one table XOR per g rows instead of one per selected row. Columns are
+// walked in blocks sized so the table stays in L2; small batches, where the
+// table would not pay for itself, XOR the selected rows directly.
+class Gf2MatMul {
+public:
+    void multiply(const uint64_t *const *rows, size_t nRows, size_t n, const uint8_t *sel, size_t K,
+                  uint64_t *acc, size_t accStride) {
+        const size_t selStride = (nRows + 7) / 8;
+        const unsigned g = groupBits(K);
+        if (g == 0) {
+            for (size_t r = 0; r < nRows; ++r) {
+                for (size_t q = 0; q < K; ++q) {
+                    if ((sel[q * selStride + r / 8] >> (r % 8)) & 1) xorInto(acc + q * accStride, rows[r], n);
+                }
+            }
+            return;
+        }
+        const size_t entries = size_t(1) << g;
+        const size_t colBlock = std::max<size_t>(8, (size_t(256) << 10) / 8 / entries);
+        table_.resize(entries * colBlock);
+        for (size_t c = 0; c < n; c += colBlock) {
+            const size_t cn = std::min(colBlock, n - c);
+            for (size_t r = 0; r < nRows; r += g) {
+                const size_t rowsHere = std::min<size_t>(g, nRows - r);
+                // table[i] = XOR of rows r + j for each set bit j of i, built from
+                // the entry without i's lowest set bit
+                std::memset(table_.data(), 0, cn * 8);
+                for (size_t i = 1; i < (size_t(1) << rowsHere); ++i) {
+                    size_t j = 0;
+                    while (!((i >> j) & 1)) ++j;
+                    uint64_t *t = table_.data() + i * colBlock;
+                    std::memcpy(t, table_.data() + (i ^ (size_t(1) << j)) * colBlock, cn * 8);
+                    xorInto(t, rows[r + j] + c, cn);
+                }
+                const size_t mask = (size_t(1) << rowsHere) - 1;
+                for (size_t q = 0; q < K; ++q) {
+                    const size_t pattern = (sel[q * selStride + r / 8] >> (r % 8)) & mask;
+                    if (pattern) xorInto(acc + q * accStride + c, table_.data() + pattern * colBlock, cn);
+                }
+            }
+        }
+    }
+
+    // Rows per table: 4 once K passes 16 (15 table XORs amortised over K),
+    // 8 once K passes 225 (255 table XORs); below that direct XOR is cheaper
+    static unsigned groupBits(size_t K) {
+        if (K > 225) return 8;
+        if (K > 16) return 4;
+        return 0;
+    }
+
+private:
+    std::vector<uint64_t> table_;
+};
+
+// Classification of 64 text chars, one bit per char (char i -> bit i):
+// which are '1', which are '0'/'1', and which are neither a digit nor
+// whitespace (space, tab, CR, LF)
+struct TextBlock {
+    uint64_t ones = 0, digits = 0, bad = 0;
+};
+
+static TextBlock classifyTextPortable(const char *p, size_t n) {
+    TextBlock b;
+    for (size_t i = 0; i < n; ++i) {
+        const char c = p[i];
+        const uint64_t bit = uint64_t(1) << i;
+        if (c == '1') b.ones |= bit;
+        if (c == '0' || c == '1') b.digits |= bit;
+        else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') b.bad |= bit;
+    }
+    return b;
+}
+
+// Gather the bits of value at the set positions of mask into the low bits
+static uint64_t extractBitsPortable(uint64_t value, uint64_t mask) {
+    uint64_t out = 0;
+    for (unsigned k = 0; mask; mask &= mask - 1, ++k) {
+        if (value & mask & (0 - mask)) out |= uint64_t(1) << k;
+    }
+    return out;
+}
+
+#ifdef PIR_X86_DISPATCH
+__attribute__((target("avx2")))
+static TextBlock classifyTextAvx2(const char *p) {
+    TextBlock b;
+    for (int half = 0; half < 2; ++half) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * half));
+        const __m256i one = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('1'));
+        const __m256i digit = _mm256_or_si256(one, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('0')));
+        const __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        const unsigned shift = 32 * static_cast<unsigned>(half);
+        b.ones |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(one))) << shift;
+        b.digits |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(digit))) << shift;
+        b.bad |= uint64_t(static_cast<uint32_t>(~_mm256_movemask_epi8(_mm256_or_si256(digit, space)))) << shift;
+    }
+    return b;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static TextBlock classifyTextAvx512(const char *p) {
+    const __m512i v = _mm512_loadu_si512(p);
+    TextBlock b;
+    b.ones = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('1'));
+    b.digits = b.ones | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('0'));
+    const uint64_t space = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' ')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t')) |
+                           _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\r'));
+    b.bad = ~(b.digits | space);
+    return b;
+}
+
+__attribute__((target("bmi2")))
+static uint64_t extractBitsBmi2(uint64_t value, uint64_t mask) {
+    return _pext_u64(value, mask);
+}
+#endif
+
+static TextBlock classifyText64(const char *p) {
+#ifdef PIR_X86_DISPATCH
+    static const int level = __builtin_cpu_supports("avx512bw") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+    if (level == 2) return classifyTextAvx512(p);
+    if (level == 1) return classifyTextAvx2(p);
+#endif
+    return classifyTextPortable(p, 64);
+}
+
+static uint64_t extractBits(uint64_t value, uint64_t mask) {
+#ifdef PIR_X86_DISPATCH
+    static const bool bmi2 = __builtin_cpu_supports("bmi2");
+    if (bmi2) return extractBitsBmi2(value, mask);
+#endif
+    return extractBitsPortable(value, mask);
+}
+
+// Reverse the bit order of a 64-bit word
+static uint64_t reverseBits64(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+// Validating parser from '0'/'1' text to MSB-first bytes. Each 64-char block
+// is classified with one or two vector compares per class (AVX-512BW / AVX2),
+// whitespace is squeezed out with pext, and the block's bits are appended to a
+// 64-bit accumulator at the current bit offset. Any other character stops the
+// parse and is reported through failed() / errorOffset() / errorChar().
+class TextBitPacker {
+public:
+    // Packs text into dst, which needs room for n / 8 + 8 bytes; returns the
+    // number of complete bytes written. Bits short of a whole byte are carried
+    // over to the next call or to finish().
+    size_t pack(const char *text, size_t n, unsigned char *dst) {
+        size_t out = 0;
+        for (size_t i = 0; i < n && !failed_; i += 64) {
+            const size_t len = std::min<size_t>(64, n - i);
+            TextBlock b = len == 64 ? classifyText64(text + i) : classifyTextPortable(text + i, len);
+            if (len < 64) b.bad &= (uint64_t(1) << len) - 1;
+            if (b.bad) {
+                const size_t at = static_cast<size_t>(countTrailingZeros(b.bad));
+                b.digits &= (uint64_t(1) << at) - 1; // keep the bits before the stray char
+                failed_ = true;
+                errorOffset_ = chars_ + i + at;
+                errorChar_ = text[i + at];
+            }
+            const unsigned count = popcount64(b.digits);
+            const uint64_t packed = b.digits == ~uint64_t(0) ? b.ones : extractBits(b.ones, b.digits);
+            append(reverseBits64(packed), count, dst, out);
+        }
+        chars_ += n;
+        return out;
+    }
+
+    // Writes the remaining bits, zero-padded to a byte; returns the bytes written
+    size_t finish(unsigned char *dst) {
+        const size_t n = (accBits_ + 7) / 8;
+        for (size_t k = 0; k < n; ++k) dst[k] = static_cast<unsigned char>(acc_ >> (56 - 8 * k));
+        acc_ = 0;
+        accBits_ = 0;
+        return n;
+    }
+
+    uint64_t bitLength() const { return bits_; }
+    bool failed() const { return failed_; }
+    uint64_t errorOffset() const { return errorOffset_; }
+    char errorChar() const { return errorChar_; }
+
+private:
+    static unsigned popcount64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_popcountll(v));
+#else
+        unsigned n = 0;
+        for (; v; v &= v - 1) ++n;
+        return n;
+#endif
+    }
+    static unsigned countTrailingZeros(uint64_t v) { // v != 0
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctzll(v));
+#else
+        unsigned n = 0;
+        while (!((v >> n) & 1)) ++n;
+        return n;
+#endif
+    }
+
+    // Append the top `count` bits of v; whole 64-bit words are written out big-endian
+    void append(uint64_t v, unsigned count, unsigned char *dst, size_t &out) {
+        if (count == 0) return;
+        if (count < 64) v &= ~uint64_t(0) << (64 - count);
+        acc_ |= v >> accBits_;
+        bits_ += count;
+        if (accBits_ + count < 64) {
+            accBits_ += count;
+            return;
+        }
+        for (int k = 0; k < 8; ++k) dst[out++] = static_cast<unsigned char>(acc_ >> (56 - 8 * k));
+        acc_ = accBits_ ? v << (64 - accBits_) : 0;
+        accBits_ = accBits_ + count - 64;
+    }
+
+    uint64_t acc_ = 0; // pending bits, MSB-aligned
+    unsigned accBits_ = 0;
+    uint64_t bits_ = 0;
+    uint64_t chars_ = 0;
+    bool failed_ = false;
+    uint64_t errorOffset_ = 0;
+    char errorChar_ = 0;
+};
+
+// ChaCha20 block function (20 rounds, 64-bit block counter in state[12..13])
+#define PIR_QR(a, b, c, d) \
+    a += b; d ^= a; d = (d << 16) | (d >> 16); \
+    c += d; b ^= c; b = (b << 12) | (b >> 20); \
+    a += b; d ^= a; d = (d << 8) | (d >> 24); \
+    c += d; b ^= c; b = (b << 7) | (b >> 25);
+
+static void chacha20Block(const uint32_t in[16], uint32_t out[16]) {
+    uint32_t x[16];
+    std::memcpy(x, in, sizeof(x));
+    for (int i = 0; i < 10; ++i) {
+        PIR_QR(x[0], x[4], x[8], x[12]) PIR_QR(x[1], x[5], x[9], x[13])
+        PIR_QR(x[2], x[6], x[10], x[14]) PIR_QR(x[3], x[7], x[11], x[15])
+        PIR_QR(x[0], x[5], x[10], x[15]) PIR_QR(x[1], x[6], x[11], x[12])
+        PIR_QR(x[2], x[7], x[8], x[13]) PIR_QR(x[3], x[4], x[9], x[14])
+    }
+    for (int i = 0; i < 16; ++i) out[i] = x[i] + in[i];
+}
+#undef PIR_QR
+
+#ifdef PIR_X86_DISPATCH
+// Eight independent ChaCha20 blocks at once (8 consecutive 16-word states in
+// and out), one block per 32-bit lane
+__attribute__((target("avx2")))
+static void chacha20Blocks8Avx2(const uint32_t in[128], uint32_t out[128]) {
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                           2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                          3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    const __m256i lane = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+    __m256i s[16], x[16];
+    for (int i = 0; i < 16; ++i) {
+        s[i] = _mm256_i32gather_epi32(reinterpret_cast<const int*>(in + i), lane, 4);
+        x[i] = s[i];
+    }
+
+#define PIR_QR8(a, b, c, d) \
+    a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); \
+    b = _mm256_or_si256(_mm256_slli_epi32(b, 12), _mm256_srli_epi32(b, 20)); \
+    a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); \
+    b = _mm256_or_si256(_mm256_slli_epi32(b, 7), _mm256_srli_epi32(b, 25));
+    for (int i = 0; i < 10; ++i) {
+        PIR_QR8(x[0], x[4], x[8], x[12]) PIR_QR8(x[1], x[5], x[9], x[13])
+        PIR_QR8(x[2], x[6], x[10], x[14]) PIR_QR8(x[3], x[7], x[11], x[15])
+        PIR_QR8(x[0], x[5], x[10], x[15]) PIR_QR8(x[1], x[6], x[11], x[12])
+        PIR_QR8(x[2], x[7], x[8], x[13]) PIR_QR8(x[3], x[4], x[9], x[14])
+    }
+#undef PIR_QR8
+
+    alignas(32) uint32_t lanes[8];
+    for (int i = 0; i < 16; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi32(x[i], s[i]));
+        for (int b = 0; b < 8; ++b) out[b * 16 + i] = lanes[b];
+    }
+}
+#endif
+
+// n independent ChaCha20 blocks, eight at a time where AVX2 is available
+static void chacha20Blocks(const uint32_t *in, uint32_t *out, size_t n) {
+    size_t b = 0;
+#ifdef PIR_X86_DISPATCH
+    if (detectSimdLevel() != SimdLevel::Portable) {
+        for (; b + 8 <= n; b += 8) chacha20Blocks8Avx2(in + b * 16, out + b * 16);
+    }
+#endif
+    for (; b < n; ++b) chacha20Block(in + b * 16, out + b * 16);
+}
+
+// Seekable counter-mode PRG over ChaCha20. A (seed, stream) pair names one
+// keystream; word w of it lives in block w / 8, so any range can be produced
+// independently and in parallel.
+class MaskPrg {
+public:
+    static const size_t kSeedBytes = 32;
+    using Seed = std::array<unsigned char, kSeedBytes>;
+
+    MaskPrg(const Seed &seed, uint64_t stream) {
+        static const uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574}; // "expand 32-byte k"
+        std::memcpy(state_, sigma, sizeof(sigma));
+        std::memcpy(state_ + 4, seed.data(), kSeedBytes);
+        state_[12] = state_[13] = 0;
+        state_[14] = static_cast<uint32_t>(stream);
+        state_[15] = static_cast<uint32_t>(stream >> 32);
+    }
+
+    static Seed randomSeed() {
+        std::random_device rd;
+        Seed seed;
+        for (size_t i = 0; i < kSeedBytes; i += 4) {
+            const uint32_t v = rd();
+            std::memcpy(seed.data() + i, &v, 4);
+        }
+        return seed;
+    }
+
+    // Write keystream words [wordOffset, wordOffset + n) to out
+    void fill(uint64_t *out, uint64_t wordOffset, size_t n) const {
+        uint64_t block = wordOffset / 8;
+        size_t skip = static_cast<size_t>(wordOffset % 8);
+        uint32_t states[128];
+        alignas(32) uint32_t buf[128];
+        while (n > 0) {
+            const size_t blocks = skip + n >= 64 ? 8 : 1;
+            for (size_t b = 0; b < blocks; ++b) {
+                uint32_t *st = states + b * 16;
+                std::memcpy(st, state_, sizeof(state_));
+                st[12] = static_cast<uint32_t>(block + b);
+                st[13] = static_cast<uint32_t>((block + b) >> 32);
+            }
+            chacha20Blocks(states, buf, blocks);
+            const size_t take = std::min(n, blocks * 8 - skip);
+            std::memcpy(out, reinterpret_cast<const uint64_t*>(buf) + skip, take * 8);
+            out += take;
+            n -= take;
+            block += blocks;
+            skip = 0;
+        }
+    }
+
+private:
+    uint32_t state_[16];
+};
+
+
+static unsigned defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Pin the calling thread to one core, wrapping around the available cores
+static void pinCurrentThread(unsigned index) {
+    const unsigned cores = defaultThreadCount();
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (index % cores % 64));
+#else
+    (void)index;
+    (void)cores;
+#endif
+}
+
+// Fixed set of worker threads, optionally pinned one per core. run() hands
+// out task indices 0..tasks-1 dynamically and returns when all are done; the
+// callback also gets the worker index so callers can keep per-worker state.
+class ThreadPool {
+public:
+    using Task = std::function<void(size_t task, unsigned worker)>;
+
+    ThreadPool(unsigned threads, bool pin) {
+        threads = std::max(1u, threads);
+        for (unsigned w = 0; w < threads; ++w) {
+            workers_.emplace_back([this, w, pin] {
+                if (pin) pinCurrentThread(w);
+                loop(w);
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &t : workers_) t.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+    void run(size_t tasks, const Task &fn) {
+        if (tasks == 0) return;
+        std::unique_lock<std::mutex> lock(mu_);
+        job_ = &fn;
+        tasks_ = tasks;
+        next_ = 0;
+        busy_ = workers_.size();
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this] { return busy_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void loop(unsigned w) {
+        uint64_t seen = 0;
+        for (;;) {
+            const Task *job;
+            size_t tasks;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+                job = job_;
+                tasks = tasks_;
+            }
+            for (size_t t; (t = next_++) < tasks;) (*job)(t, w);
+            std::lock_guard<std::mutex> lock(mu_);
+            if (--busy_ == 0) done_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mu_;
+    std::condition_variable wake_, done_;
+    const Task *job_ = nullptr;
+    size_t tasks_ = 0;
+    std::atomic<size_t> next_{0};
+    size_t busy_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+// r1 and r2 are two streams of one seed; only the seed is handed to the client
+static const uint64_t kMaskStreamR1 = 1;
+static const uint64_t kMaskStreamR2 = 2;
+static const char *kMaskSeedFile = "mask_seed.bin";
+
+static bool writeMaskSeed(const fs::path &path, const MaskPrg::Seed &seed) {
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(seed.data()), static_cast<std::streamsize>(seed.size()));
+    return static_cast<bool>(out);
+}
+
+static bool readMaskSeed(const fs::path &path, MaskPrg::Seed &seed) {
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.is_open()) return false;
+    in.read(reinterpret_cast<char*>(seed.data()), static_cast<std::streamsize>(seed.size()));
+    return in.gcount() == static_cast<std::streamsize>(seed.size());
+}
+
+// Distributed point function (Boyle-Gilboa-Ishai tree construction) for
+// f(x) = [x == alpha] over 2^depth indices. Each of the two keys is O(depth)
+// bytes; XORing the two full-domain evaluations gives the unit vector e_alpha,
+// while either evaluation alone looks random. The length-doubling PRG is
+// ChaCha20 keyed by the 128-bit node seed, expanded eight nodes per AVX2 call.
+struct DpfSeed {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+struct DpfCorrection {
+    DpfSeed seed{};
+    uint8_t tLeft = 0;
+    uint8_t tRight = 0;
+};
+
+struct DpfKey {
+    uint8_t party = 0;
+    uint8_t depth = 0;
+    DpfSeed seed{};
+    std::vector<DpfCorrection> corrections; // one per tree level
+
+    // party, depth, seed, then 16-byte seed + control-bit byte per level
+    std::vector<unsigned char> serialize() const {
+        std::vector<unsigned char> out(2 + 16 + 17 * corrections.size());
+        out[0] = party;
+        out[1] = depth;
+        std::memcpy(&out[2], &seed, 16);
+        for (size_t i = 0; i < corrections.size(); ++i) {
+            std::memcpy(&out[18 + 17 * i], &corrections[i].seed, 16);
+            out[18 + 17 * i + 16] = static_cast<unsigned char>(corrections[i].tLeft | (corrections[i].tRight << 1));
+        }
+        return out;
+    }
+
+    static bool deserialize(const unsigned char *data, size_t n, DpfKey &key) {
+        if (n < 18 || data[0] > 1 || data[1] > 63 || n != 18 + 17 * static_cast<size_t>(data[1])) return false;
+        key.party = data[0];
+        key.depth = data[1];
+        std::memcpy(&key.seed, data + 2, 16);
+        key.corrections.resize(key.depth);
+        for (size_t i = 0; i < key.depth; ++i) {
+            std::memcpy(&key.corrections[i].seed, data + 18 + 17 * i, 16);
+            key.corrections[i].tLeft = data[18 + 17 * i + 16] & 1;
+            key.corrections[i].tRight = (data[18 + 17 * i + 16] >> 1) & 1;
+        }
+        return true;
+    }
+};
+
+static unsigned dpfDepthFor(size_t total) {
+    unsigned depth = 1;
+    while (depth < 63 && (static_cast<uint64_t>(1) << depth) < total) ++depth;
+    return depth;
+}
+
+// G(s) for n node seeds: children[2j] / children[2j + 1] are the left / right
+// child seeds of in[j], with their control bits in childT
+static void dpfExpand(const DpfSeed *in, size_t n, DpfSeed *children, uint8_t *childT) {
+    static const uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    const size_t batch = 64;
+    uint32_t states[batch * 16];
+    alignas(32) uint32_t out[batch * 16];
+    for (size_t base = 0; base < n; base += batch) {
+        const size_t m = std::min(batch, n - base);
+        for (size_t b = 0; b < m; ++b) {
+            uint32_t *st = states + b * 16;
+            std::memset(st, 0, 64);
+            std::memcpy(st, sigma, sizeof(sigma));
+            std::memcpy(st + 4, &in[base + b], 16);
+        }
+        chacha20Blocks(states, out, m);
+        for (size_t b = 0; b < m; ++b) {
+            const uint32_t *o = out + b * 16;
+            std::memcpy(&children[2 * (base + b)], o, 16);
+            std::memcpy(&children[2 * (base + b) + 1], o + 4, 16);
+            childT[2 * (base + b)] = o[8] & 1;
+            childT[2 * (base + b) + 1] = o[9] & 1;
+        }
+    }
+}
+
+static DpfSeed randomDpfSeed() {
+    const MaskPrg::Seed r = MaskPrg::randomSeed();
+    DpfSeed seed;
+    std::memcpy(&seed, r.data(), 16);
+    return seed;
+}
+
+static void dpfGenerate(uint64_t alpha, unsigned depth, DpfKey &k0, DpfKey &k1) {
+    DpfSeed s[2] = {randomDpfSeed(), randomDpfSeed()};
+    uint8_t t[2] = {0, 1};
+    k0 = DpfKey();
+    k1 = DpfKey();
+    k0.party = 0;
+    k1.party = 1;
+    k0.depth = k1.depth = static_cast<uint8_t>(depth);
+    k0.seed = s[0];
+    k1.seed = s[1];
+    for (unsigned level = 0; level < depth; ++level) {
+        DpfSeed child[2][2];
+        uint8_t childT[2][2];
+        dpfExpand(&s[0], 1, child[0], childT[0]);
+        dpfExpand(&s[1], 1, child[1], childT[1]);
+        const unsigned keep = static_cast<unsigned>((alpha >> (depth - 1 - level)) & 1);
+        const unsigned lose = keep ^ 1;
+
+        DpfCorrection cw;
+        cw.seed.lo = child[0][lose].lo ^ child[1][lose].lo;
+        cw.seed.hi = child[0][lose].hi ^ child[1][lose].hi;
+        cw.tLeft = static_cast<uint8_t>(childT[0][0] ^ childT[1][0] ^ keep ^ 1);
+        cw.tRight = static_cast<uint8_t>(childT[0][1] ^ childT[1][1] ^ keep);
+        const uint8_t tKeepCw = keep ? cw.tRight : cw.tLeft;
+        for (int b = 0; b < 2; ++b) {
+            s[b] = child[b][keep];
+            if (t[b]) {
+                s[b].lo ^= cw.seed.lo;
+                s[b].hi ^= cw.seed.hi;
+            }
+            t[b] = static_cast<uint8_t>(childT[b][keep] ^ (t[b] & tKeepCw));
+        }
+        k0.corrections.push_back(cw);
+        k1.corrections.push_back(cw);
+    }
+}
+
+// Expand one tree level: children of `n` nodes, corrected, truncated to `keep`
+static void dpfExpandLevel(const DpfSeed *seeds, const uint8_t *t, size_t n, const DpfCorrection &cw,
+                           DpfSeed *children, uint8_t *childT, size_t keep) {
+    dpfExpand(seeds, n, children, childT);
+    for (size_t j = 0; j < n; ++j) {
+        if (!t[j]) continue;
+        for (size_t c = 2 * j; c < 2 * j + 2 && c < keep; ++c) {
+            children[c].lo ^= cw.seed.lo;
+            children[c].hi ^= cw.seed.hi;
+        }
+        childT[2 * j] ^= cw.tLeft;
+        childT[2 * j + 1] ^= cw.tRight;
+    }
+}
+
+// Evaluate a key on every index in [0, total). The top of the tree is expanded
+// breadth-first; below it, subtrees of up to 4096 leaves are expanded in
+// cache-resident buffers, spread across the pool.
+static BitVector dpfEvalFull(const DpfKey &key, size_t total, ThreadPool &pool) {
+    BitVector out(total);
+    if (total == 0) return out;
+    const unsigned depth = key.depth;
+    const unsigned subHeight = std::min(depth, 12u);
+    const unsigned topLevels = depth - subHeight;
+    auto nodesNeeded = [&](unsigned level) { // nodes at `level` covering [0, total)
+        const unsigned shift = depth - level;
+        return static_cast<size_t>(((static_cast<uint64_t>(total) - 1) >> shift) + 1);
+    };
+
+    std::vector<DpfSeed> frontier(1, key.seed), next;
+    std::vector<uint8_t> frontierT(1, key.party), nextT;
+    for (unsigned level = 0; level < topLevels; ++level) {
+        next.resize(frontier.size() * 2);
+        nextT.resize(frontier.size() * 2);
+        const size_t keep = nodesNeeded(level + 1);
+        dpfExpandLevel(frontier.data(), frontierT.data(), frontier.size(), key.corrections[level],
+                       next.data(), nextT.data(), keep);
+        next.resize(keep);
+        nextT.resize(keep);
+        frontier.swap(next);
+        frontierT.swap(nextT);
+    }
+
+    // Subtrees of at least 64 leaves own whole words of `out`, so workers never share one
+    struct Scratch {
+        std::vector<DpfSeed> a, b;
+        std::vector<uint8_t> at, bt;
+    };
+    std::vector<Scratch> scratch(pool.size());
+    auto expandSubtree = [&](size_t root, Scratch &sc) {
+        const size_t width = size_t(1) << subHeight;
+        sc.a.resize(width);
+        sc.b.resize(width);
+        sc.at.resize(width);
+        sc.bt.resize(width);
+        auto &a = sc.a, &b = sc.b;
+        auto &at = sc.at, &bt = sc.bt;
+        const size_t firstLeaf = root << subHeight;
+        a[0] = frontier[root];
+        at[0] = frontierT[root];
+        size_t count = 1;
+        for (unsigned h = 0; h < subHeight; ++h) {
+            const unsigned level = topLevels + h;
+            const size_t shift = depth - level - 1;
+            const size_t keep = std::min(count * 2, ((total - 1 - firstLeaf) >> shift) + 1);
+            dpfExpandLevel(a.data(), at.data(), count, key.corrections[level], b.data(), bt.data(), keep);
+            a.swap(b);
+            at.swap(bt);
+            count = keep;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            if (at[k]) out.set(firstLeaf + k, true);
+        }
+    };
+    if (subHeight >= 6) {
+        pool.run(frontier.size(), [&](size_t root, unsigned worker) { expandSubtree(root, scratch[worker]); });
+    } else {
+        for (size_t root = 0; root < frontier.size(); ++root) expandSubtree(root, scratch[0]);
+    }
+    return out;
+}
+
+// Read-only mapping of a whole file. Pages are served from the page cache on
+// first touch, so opening even a multi-GB file is a couple of syscalls. Large
+// mappings are advised for sequential readahead and transparent huge pages.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+#ifdef _WIN32
+            std::swap(file_, other.file_);
+            std::swap(mapping_, other.mapping_);
+#endif
+        }
+        return *this;
+    }
+
+    bool open(const fs::path &path) {
+        close();
+#ifdef _WIN32
+        file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) return false;
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0) return true;
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_) return false;
+        data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        return data_ != nullptr;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return true;
+        }
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (p == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        data_ = static_cast<const unsigned char*>(p);
+        madvise(p, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if (size_ >= (2u << 20)) madvise(p, size_, MADV_HUGEPAGE);
+#endif
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const unsigned char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Drop already-consumed pages from this process's working set; they stay
+    // in the page cache and are faulted back in if touched again
+    void release(size_t offset, size_t len) const {
+#ifndef _WIN32
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t begin = offset / page * page;
+        const size_t end = std::min(size_, offset + len) / page * page;
+        if (data_ && end > begin) madvise(const_cast<unsigned char*>(data_) + begin, end - begin, MADV_DONTNEED);
+#else
+        (void)offset;
+        (void)len;
+#endif
+    }
+
+private:
+    const unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+// How the server pulls record bytes off disk: through the page cache via
+// mmap, or with explicit O_DIRECT block reads (io_uring, or pread threads
+// where io_uring is unavailable) for databases that do not fit in memory
+enum class IoBackend { Mmap, Uring, Pread };
+
+#ifndef _WIN32
+// File descriptor opened for direct I/O, falling back to buffered reads on
+// filesystems that reject O_DIRECT (tmpfs, some overlays)
+class DirectFile {
+public:
+    DirectFile() = default;
+    ~DirectFile() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    DirectFile(const DirectFile &) = delete;
+    DirectFile &operator=(const DirectFile &) = delete;
+
+    bool open(const fs::path &path) {
+#ifdef O_DIRECT
+        fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+        if (fd_ >= 0) return true;
+#endif
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        return fd_ >= 0;
+    }
+
+    int fd() const { return fd_; }
+
+private:
+    int fd_ = -1;
+};
+
+// Page-aligned scratch memory, as O_DIRECT requires
+class AlignedBuffer {
+public:
+    ~AlignedBuffer() { std::free(data_); }
+
+    unsigned char *reserve(size_t bytes) {
+        if (bytes > size_) {
+            std::free(data_);
+            void *p = nullptr;
+            if (posix_memalign(&p, kAlign, bytes) != 0) p = nullptr;
+            data_ = static_cast<unsigned char*>(p);
+            size_ = data_ ? bytes : 0;
+        }
+        return data_;
+    }
+
+    static const size_t kAlign = 4096;
+
+private:
+    unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct ReadRequest {
+    int fd;
+    uint64_t offset;
+    size_t len;
+    unsigned char *dst;
+};
+
+// Executes a batch of positional reads with as many in flight as the backend
+// allows; bytes past end of file come back as zeros
+class BlockReader {
+public:
+    virtual ~BlockReader() = default;
+    virtual bool readAll(const std::vector<ReadRequest> &reqs) = 0;
+    virtual const char *name() const = 0;
+};
+
+class PreadBlockReader : public BlockReader {
+public:
+    explicit PreadBlockReader(unsigned threads) : pool_(threads, false) {}
+
+    bool readAll(const std::vector<ReadRequest> &reqs) override {
+        std::atomic<bool> ok{true};
+        pool_.run(reqs.size(), [&](size_t i, unsigned) {
+            const ReadRequest &r = reqs[i];
+            size_t done = 0;
+            while (done < r.len) {
+                const ssize_t got = pread(r.fd, r.dst + done, r.len - done, static_cast<off_t>(r.offset + done));
+                if (got < 0) {
+                    ok = false;
+                    return;
+                }
+                if (got == 0) break;
+                done += static_cast<size_t>(got);
+            }
+            std::memset(r.dst + done, 0, r.len - done);
+        });
+        return ok;
+    }
+
+    const char *name() const override { return "pread"; }
+
+private:
+    ThreadPool pool_;
+};
+
+#ifdef PIR_HAVE_IO_URING
+// Minimal io_uring driver on the raw syscalls (no liburing dependency): one
+// submission/completion ring pair per reader, refilled as completions arrive
+class UringBlockReader : public BlockReader {
+public:
+    static std::unique_ptr<UringBlockReader> create(unsigned depth) {
+        std::unique_ptr<UringBlockReader> r(new UringBlockReader());
+        return r->setup(depth) ? std::move(r) : nullptr;
+    }
+
+    ~UringBlockReader() override {
+        if (sqes_) munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_) munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool readAll(const std::vector<ReadRequest> &reqs) override {
+        std::vector<size_t> done(reqs.size(), 0);
+        std::vector<size_t> pending; // request indices waiting for a submission slot
+        for (size_t i = reqs.size(); i-- > 0;) pending.push_back(i);
+        size_t inFlight = 0;
+        unsigned queued = 0; // in the submission ring, not yet taken by the kernel
+        bool failed = false;
+        while ((!pending.empty() && !failed) || inFlight > 0 || (queued > 0 && !failed)) {
+            unsigned tail = *sqTail_;
+            while (!pending.empty() && !failed && inFlight + queued < entries_) {
+                const size_t i = pending.back();
+                pending.pop_back();
+                const unsigned idx = tail & *sqMask_;
+                io_uring_sqe *sqe = &sqes_[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = reqs[i].fd;
+                sqe->addr = reinterpret_cast<uint64_t>(reqs[i].dst + done[i]);
+                sqe->len = static_cast<uint32_t>(reqs[i].len - done[i]);
+                sqe->off = reqs[i].offset + done[i];
+                sqe->user_data = i;
+                sqArray_[idx] = idx;
+                ++tail;
+                ++queued;
+            }
+            __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+            // The kernel may take fewer entries than offered; the rest stay
+            // queued and are offered again. Once a read has failed nothing new
+            // is submitted, but in-flight reads are waited for: their buffers
+            // belong to the caller.
+            const unsigned offer = failed ? 0 : queued;
+            const long submitted = syscall(__NR_io_uring_enter, fd_, offer, inFlight + offer > 0 ? 1 : 0,
+                                           IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR || ((errno == EAGAIN || errno == EBUSY) && inFlight > 0)) continue;
+                if (failed) break; // the ring itself is unusable
+                failed = true;
+                continue;
+            }
+            queued -= static_cast<unsigned>(submitted);
+            inFlight += static_cast<size_t>(submitted);
+            if (failed && inFlight == 0) break;
+
+            unsigned head = *cqHead_;
+            while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+                const size_t i = static_cast<size_t>(cqe.user_data);
+                ++head;
+                --inFlight;
+                if (cqe.res < 0) {
+                    failed = true;
+                    continue;
+                }
+                if (failed) continue;
+                done[i] += static_cast<size_t>(cqe.res);
+                if (cqe.res == 0 || done[i] >= reqs[i].len) {
+                    std::memset(reqs[i].dst + done[i], 0, reqs[i].len - std::min(done[i], reqs[i].len));
+                    done[i] = reqs[i].len;
+                } else {
+                    pending.push_back(i); // short read: queue the remainder
+                }
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        }
+        // Withdraw entries the kernel never took so a later batch does not
+        // submit them (safe without SQPOLL: the kernel only reads the ring
+        // inside io_uring_enter)
+        if (queued > 0) __atomic_store_n(sqTail_, *sqTail_ - queued, __ATOMIC_RELEASE);
+        return !failed;
+    }
+
+    const char *name() const override { return "io_uring"; }
+
+private:
+    UringBlockReader() = default;
+
+    bool setup(unsigned depth) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, depth, &p));
+        if (fd_ < 0) return false;
+        entries_ = p.sq_entries;
+        sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            sqRing_ = nullptr;
+            return false;
+        }
+        cqRing_ = single ? sqRing_
+                         : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            return false;
+        }
+        sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto *sq = static_cast<unsigned char*>(sqRing_);
+        auto *cq = static_cast<unsigned char*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask_ = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask_ = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return supportsRead();
+    }
+
+    // Whether the kernel implements IORING_OP_READ (5.6+). Kernels that old
+    // also lack IORING_REGISTER_PROBE, so a failed probe means no.
+    bool supportsRead() const {
+        const unsigned ops = 256;
+        std::vector<unsigned char> buf(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, ops) < 0) return false;
+        return IORING_OP_READ <= probe->last_op && IORING_OP_READ < probe->ops_len &&
+               (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    void *sqRing_ = nullptr;
+    void *cqRing_ = nullptr;
+    size_t sqRingSize_ = 0, cqRingSize_ = 0, sqesSize_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    unsigned *sqTail_ = nullptr, *sqMask_ = nullptr, *sqArray_ = nullptr;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, *cqMask_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+};
+#endif
+
+// io_uring when asked for and able to read files, pread threads otherwise
+static std::unique_ptr<BlockReader> makeBlockReader(IoBackend backend, unsigned depth) {
+#ifdef PIR_HAVE_IO_URING
+    if (backend == IoBackend::Uring) {
+        if (auto r = UringBlockReader::create(depth)) return r;
+        static std::once_flag warned;
+        std::call_once(warned, [] { std::cout << "[WARN] io_uring unavailable or cannot read files; using pread threads\n"; });
+    }
+#endif
+    (void)backend;
+    return std::unique_ptr<BlockReader>(new PreadBlockReader(std::min(depth, 16u)));
+}
+
+// Gathers byte-range reads from several files into one BlockReader batch.
+// Ranges are widened to 4 KB alignment for O_DIRECT, ranges added back to back
+// on disk are merged, and the result is split into 256 KB requests landing in
+// an aligned bounce buffer, then copied to their targets.
+class RecordFetcher {
+public:
+    explicit RecordFetcher(BlockReader &reader) : reader_(reader) {}
+
+    // dst receives bytes [offset, offset + len) of fd; bytes past EOF are zero
+    void add(int fd, uint64_t offset, size_t len, void *dst) {
+        const size_t a = AlignedBuffer::kAlign;
+        Fetch f;
+        f.fd = fd;
+        f.alignedOffset = offset / a * a;
+        f.skip = static_cast<size_t>(offset - f.alignedOffset);
+        f.alignedLen = (f.skip + len + a - 1) / a * a;
+        f.len = len;
+        f.dst = static_cast<unsigned char*>(dst);
+        f.bounceOffset = bounceBytes_;
+        bounceBytes_ += f.alignedLen;
+        fetches_.push_back(f);
+    }
+
+    bool run() {
+        unsigned char *bounce = bounce_.reserve(bounceBytes_);
+        if (!bounce && bounceBytes_ > 0) return false;
+        const size_t piece = 256 << 10;
+        std::vector<ReadRequest> reqs;
+        for (size_t k = 0; k < fetches_.size();) {
+            // Bounce ranges follow add() order, so fetches that continue each
+            // other on disk are adjacent in the bounce buffer too
+            const Fetch &f = fetches_[k];
+            size_t len = f.alignedLen;
+            for (++k; k < fetches_.size() && fetches_[k].fd == f.fd && fetches_[k].alignedOffset == f.alignedOffset + len; ++k) {
+                len += fetches_[k].alignedLen;
+            }
+            for (size_t off = 0; off < len; off += piece) {
+                reqs.push_back({f.fd, f.alignedOffset + off, std::min(piece, len - off), bounce + f.bounceOffset + off});
+            }
+        }
+        const bool ok = reader_.readAll(reqs);
+        if (ok) {
+            for (const Fetch &f : fetches_) std::memcpy(f.dst, bounce + f.bounceOffset + f.skip, f.len);
+        }
+        fetches_.clear();
+        bounceBytes_ = 0;
+        return ok;
+    }
+
+private:
+    struct Fetch {
+        int fd;
+        uint64_t alignedOffset;
+        size_t alignedLen;
+        size_t skip;
+        size_t len;
+        unsigned char *dst;
+        size_t bounceOffset;
+    };
+
+    BlockReader &reader_;
+    std::vector<Fetch> fetches_;
+    AlignedBuffer bounce_;
+    size_t bounceBytes_ = 0;
+};
+
+// Direct-I/O fetchers of a database scan, one per pool worker. Each is made
+// on the worker's first direct read and kept until the database goes away,
+// so answer passes reuse their io_uring rings or pread threads.
+class ScanReaders {
+public:
+    ScanReaders(IoBackend backend, unsigned depth) : backend_(backend), depth_(depth) {}
+
+    // Make room for `workers` slots; call before the workers start
+    void reserve(size_t workers) {
+        if (slots_.size() < workers) slots_.resize(workers);
+    }
+
+    // Worker `worker`'s fetcher; only that worker may call this for its slot
+    RecordFetcher &fetcher(size_t worker) {
+        Slot &s = slots_[worker];
+        if (!s.fetcher) {
+            s.reader = makeBlockReader(backend_, depth_);
+            s.fetcher.reset(new RecordFetcher(*s.reader));
+        }
+        return *s.fetcher;
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<BlockReader> reader;
+        std::unique_ptr<RecordFetcher> fetcher;
+    };
+
+    IoBackend backend_;
+    unsigned depth_;
+    std::vector<Slot> slots_;
+};
+#endif
+
+// Packed record store: a 64-byte header followed by the bits packed MSB-first,
+// so the payload of a record is byte-for-byte the original video.
+static const char kRecordMagic[8] = {'P', 'I', 'R', 'R', 'E', 'C', '0', '1'};
+static const uint32_t kRecordVersion = 1;
+static const std::string kRecordSuffix = ".rec";
+static const std::string kTextSuffix = ".binary.txt";
+
+struct RecordHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t bitLength;
+    uint64_t checksum;
+    unsigned char reserved[32];
+};
+static_assert(sizeof(RecordHeader) == 64, "record header must stay 64 bytes");
+
+static const uint64_t kChecksumSeed = 1469598103934665603ULL;
+
+// FNV-1a over 64-bit words (bytes for the tail). Chain calls by passing the
+// previous result as seed; every chunk except the last must be a multiple of 8 bytes.
+static uint64_t recordChecksum(const unsigned char *data, size_t n, uint64_t h = kChecksumSeed) {
+    const uint64_t prime = 1099511628211ULL;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * prime;
+    }
+    for (; i < n; ++i) h = (h ^ data[i]) * prime;
+    return h;
+}
+
+static bool hasSuffix(const std::string &name, const std::string &suffix) {
+    return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Video name without the .rec / .binary.txt database suffix
+static std::string recordDisplayName(const std::string &fileName) {
+    if (hasSuffix(fileName, kRecordSuffix)) return fileName.substr(0, fileName.size() - kRecordSuffix.size());
+    if (hasSuffix(fileName, kTextSuffix)) return fileName.substr(0, fileName.size() - kTextSuffix.size());
+    return fileName;
+}
+
+static bool validRecordHeader(const RecordHeader &hdr) {
+    if (std::memcmp(hdr.magic, kRecordMagic, sizeof(kRecordMagic)) != 0) return false;
+    return hdr.version == kRecordVersion && hdr.headerSize == sizeof(RecordHeader);
+}
+
+static bool readRecordHeader(std::istream &in, RecordHeader &hdr) {
+    in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+    return in && validRecordHeader(hdr);
+}
+
+// Header of a mapped record, checking the payload is fully present
+static bool parseRecordHeader(const MappedFile &map, RecordHeader &hdr) {
+    if (map.size() < sizeof(RecordHeader)) return false;
+    std::memcpy(&hdr, map.data(), sizeof(hdr));
+    return validRecordHeader(hdr) && map.size() - sizeof(RecordHeader) >= (hdr.bitLength + 7) / 8;
+}
+
+static bool isPackedRecordFile(const fs::path &path) {
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    RecordHeader hdr;
+    return in.is_open() && readRecordHeader(in, hdr);
+}
+
+static RecordHeader makeRecordHeader(uint64_t bitLength, uint64_t checksum) {
+    RecordHeader hdr{};
+    std::memcpy(hdr.magic, kRecordMagic, sizeof(kRecordMagic));
+    hdr.version = kRecordVersion;
+    hdr.headerSize = sizeof(RecordHeader);
+    hdr.bitLength = bitLength;
+    hdr.checksum = checksum;
+    return hdr;
+}
+
+// Copy a mapped packed record into a BitVector and verify its checksum
+static bool readRecordFile(const fs::path &path, BitVector &outBits) {
+    MappedFile map;
+    RecordHeader hdr;
+    if (!map.open(path) || !parseRecordHeader(map, hdr)) return false;
+    outBits.resize(static_cast<size_t>(hdr.bitLength));
+    std::memcpy(outBits.bytes(), map.data() + sizeof(RecordHeader), outBits.byteSize());
+    outBits.clearTail();
+    if (recordChecksum(outBits.bytes(), outBits.byteSize()) != hdr.checksum) {
+        std::cout << "[ERROR] Checksum mismatch in " << path.string() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Report a stray character found by TextBitPacker; true if the text was clean
+static bool textParseOk(const TextBitPacker &packer, const fs::path &path) {
+    if (!packer.failed()) return true;
+    const unsigned char c = static_cast<unsigned char>(packer.errorChar());
+    std::cout << "[ERROR] Invalid character ";
+    if (c >= 0x20 && c < 0x7F) std::cout << "'" << static_cast<char>(c) << "' ";
+    std::cout << "(0x" << std::hex << static_cast<unsigned>(c) << std::dec << ") at offset " << packer.errorOffset()
+              << " in " << path.string() << "; expected only '0', '1' and whitespace\n";
+    return false;
+}
+
+// Read a database file into packed bits: packed records are detected by
+// their header, anything else is parsed and validated as '0'/'1' text straight
+// from the mapping
+static bool readBitsFile(const fs::path &path, BitVector &outBits) {
+    if (isPackedRecordFile(path)) return readRecordFile(path, outBits);
+    MappedFile map;
+    if (!map.open(path)) return false;
+    outBits = BitVector((map.size() / 8 + 8) * 8);
+    TextBitPacker packer;
+    const size_t bytes = packer.pack(reinterpret_cast<const char*>(map.data()), map.size(), outBits.bytes());
+    packer.finish(outBits.bytes() + bytes);
+    outBits.resize(static_cast<size_t>(packer.bitLength()));
+    return textParseOk(packer, path);
+}
+
+// Word-level access to one record for the server. Packed records are mapped
+// and served straight from the page cache; legacy text records are parsed
+// once into an owned buffer. Ranges reaching past the payload are zero-padded.
+class RecordView {
+public:
+    RecordView() = default;
+    RecordView(const RecordView &) = delete;
+    RecordView &operator=(const RecordView &) = delete;
+    RecordView(RecordView &&) = default;
+    RecordView &operator=(RecordView &&) = default;
+
+    bool open(const fs::path &path) {
+        RecordHeader hdr;
+        path_ = path;
+        auto map = std::make_shared<MappedFile>();
+        if (map->open(path) && parseRecordHeader(*map, hdr)) {
+            map_ = map;
+            payloadOffset_ = sizeof(RecordHeader);
+            payload_ = map_->data() + payloadOffset_;
+            bitLength_ = hdr.bitLength;
+            return true;
+        }
+        if (!readBitsFile(path, owned_)) return false;
+        payload_ = owned_.bytes();
+        bitLength_ = owned_.size();
+        return true;
+    }
+
+    // One record inside a shared mapping of a multi-record file (path), with
+    // its packed bits cut into tiles of tileBytes: tile j starts at byte
+    // offset + j * tileStride
+    static RecordView tiled(std::shared_ptr<const MappedFile> map, const fs::path &path, uint64_t offset, uint64_t bitLength,
+                            size_t tileBytes, uint64_t tileStride) {
+        RecordView v;
+        v.path_ = path;
+        v.map_ = std::move(map);
+        v.payloadOffset_ = offset;
+        v.payload_ = v.map_->data() + offset;
+        v.bitLength_ = bitLength;
+        v.tileBytes_ = tileBytes;
+        v.tileStride_ = tileStride;
+        return v;
+    }
+
+    // Non-owning view of bits already in memory
+    static RecordView of(const BitVector &bits) {
+        RecordView v;
+        v.payload_ = bits.bytes();
+        v.bitLength_ = bits.size();
+        return v;
+    }
+
+    uint64_t bitLength() const { return bitLength_; }
+    size_t wordCount() const { return static_cast<size_t>((bitLength_ + 63) / 64); }
+
+    // Words [w, w + n): a pointer into the payload when the range is fully
+    // backed by it and within one tile, otherwise a zero-padded copy in `staging`
+    const uint64_t *words(size_t w, size_t n, std::vector<uint64_t> &staging) const {
+        const size_t payloadBytes = static_cast<size_t>((bitLength_ + 7) / 8);
+        if ((w + n) * 8 <= payloadBytes && runAt(w * 8) >= n * 8) {
+            return reinterpret_cast<const uint64_t*>(payload_ + locate(w * 8));
+        }
+        staging.resize(n);
+        copyWords(w, n, staging.data());
+        return staging.data();
+    }
+
+    // Copy words [w, w + n) into dst, zero-padded past the payload; touching the
+    // mapping here is what pulls the pages in from disk
+    void copyWords(size_t w, size_t n, uint64_t *dst) const {
+        const size_t payloadBytes = static_cast<size_t>((bitLength_ + 7) / 8);
+        const size_t begin = std::min(payloadBytes, w * 8);
+        const size_t len = std::min(payloadBytes - begin, n * 8);
+        unsigned char *out = reinterpret_cast<unsigned char*>(dst);
+        for (size_t done = 0; done < len;) {
+            const size_t run = std::min(len - done, runAt(begin + done));
+            std::memcpy(out + done, payload_ + locate(begin + done), run);
+            done += run;
+        }
+        std::memset(out + len, 0, n * 8 - len);
+    }
+
+    // Done with words [w, w + n): let mapped pages go (no-op for in-memory records)
+    void release(size_t w, size_t n) const {
+        if (!map_) return;
+        for (size_t done = 0; done < n * 8;) {
+            const size_t run = std::min(n * 8 - done, runAt(w * 8 + done));
+            map_->release(payloadOffset_ + locate(w * 8 + done), run);
+            done += run;
+        }
+    }
+
+#ifndef _WIN32
+    // Serve fetchWords() with block reads instead of the mapping; only packed
+    // records qualify, text records stay in memory
+    bool enableDirectReads() {
+        if (!map_) return false;
+        auto file = std::make_shared<DirectFile>();
+        if (!file->open(path_)) return false;
+        direct_ = file;
+        return true;
+    }
+
+    // Same, reading through a descriptor shared with other records of the file
+    bool enableDirectReads(std::shared_ptr<const DirectFile> file) {
+        if (!map_ || !file || file->fd() < 0) return false;
+        direct_ = std::move(file);
+        return true;
+    }
+
+    // Like copyWords(), but with direct reads enabled the copy is queued on
+    // `fetcher` and dst is only filled once fetcher.run() returns
+    void fetchWords(RecordFetcher &fetcher, size_t w, size_t n, uint64_t *dst) const {
+        if (!direct_) {
+            copyWords(w, n, dst);
+            return;
+        }
+        const size_t payloadBytes = static_cast<size_t>((bitLength_ + 7) / 8);
+        const size_t begin = std::min(payloadBytes, w * 8);
+        const size_t len = std::min(payloadBytes - begin, n * 8);
+        unsigned char *out = reinterpret_cast<unsigned char*>(dst);
+        std::memset(out + len, 0, n * 8 - len);
+        for (size_t done = 0; done < len;) {
+            const size_t run = std::min(len - done, runAt(begin + done));
+            fetcher.add(direct_->fd(), payloadOffset_ + locate(begin + done), run, out + done);
+            done += run;
+        }
+    }
+#endif
+
+private:
+    // Offset of payload byte b from payload_, and how many bytes from b on
+    // are contiguous there
+    uint64_t locate(size_t b) const { return tileBytes_ ? b / tileBytes_ * tileStride_ + b % tileBytes_ : b; }
+    size_t runAt(size_t b) const { return tileBytes_ ? tileBytes_ - b % tileBytes_ : SIZE_MAX; }
+
+    fs::path path_;
+    std::shared_ptr<const MappedFile> map_;
+    uint64_t payloadOffset_ = 0;
+#ifndef _WIN32
+    std::shared_ptr<const DirectFile> direct_;
+#endif
+    BitVector owned_;
+    const unsigned char *payload_ = nullptr;
+    uint64_t bitLength_ = 0;
+    size_t tileBytes_ = 0; // 0: the payload is contiguous
+    uint64_t tileStride_ = 0;
+};
+
+// Streaming D0.r1 + D1.r2: each call covers one window of record words and
+// regenerates only that window of r1 and r2 from the seed, so neither mask is
+// ever held in full. The window is split into pieces on PRG block boundaries
+// and each pool task generates its piece of both masks and combines it.
+class MaskedCombiner {
+public:
+    MaskedCombiner(const MaskPrg::Seed &seed, ThreadPool &pool)
+        : p1_(seed, kMaskStreamR1), p2_(seed, kMaskStreamR2), pool_(pool) {}
+
+    // out[0, n) = (d0 & r1) ^ (d1 & r2) over record words [w, w + n)
+    void combine(uint64_t *out, const uint64_t *d0, const uint64_t *d1, size_t w, size_t n) {
+        r1_.resize(n);
+        r2_.resize(n);
+        const size_t minPerTask = 1 << 16; // 512 KB per mask; smaller pieces are not worth a hand-off
+        const size_t tasks = std::max<size_t>(1, std::min<size_t>(pool_.size(), n / minPerTask));
+        const size_t per = (n / tasks + 7) / 8 * 8;
+        auto piece = [&](size_t t, unsigned) {
+            const size_t begin = t * per;
+            if (begin >= n) return;
+            const size_t len = std::min(per, n - begin);
+            p1_.fill(r1_.data() + begin, w + begin, len);
+            p2_.fill(r2_.data() + begin, w + begin, len);
+            combineMasked(out + begin, d0 + begin, r1_.data() + begin, d1 + begin, r2_.data() + begin, len);
+        };
+        if (tasks == 1) {
+            piece(0, 0);
+        } else {
+            pool_.run(tasks, piece);
+        }
+    }
+
+private:
+    MaskPrg p1_, p2_;
+    ThreadPool &pool_;
+    std::vector<uint64_t> r1_, r2_;
+};
+
+// Peak working-set budget for the streaming paths: chunks are sized so that
+// all per-chunk buffers of a stage together stay under the limit
+struct StreamConfig {
+    size_t memoryLimit = size_t(64) << 20;
+    IoBackend io = IoBackend::Mmap;
+    unsigned ioDepth = 64; // reads kept in flight by the direct I/O backends
+
+    size_t chunkWords(size_t buffers) const {
+        const size_t words = memoryLimit / (8 * std::max<size_t>(1, buffers));
+        return std::max<size_t>(1024, words / 8 * 8); // whole PRG blocks
+    }
+};
+
+// Blocking FIFO handing chunk slots between pipeline stages; pop() returns
+// false once the queue is closed and drained
+template <typename T>
+class BlockingQueue {
+public:
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            items_.push_back(std::move(item));
+        }
+        ready_.notify_one();
+    }
+
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mu_);
+        ready_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.erase(items_.begin());
+        return true;
+    }
+
+    // Non-blocking pop: false when nothing is queued right now
+    bool tryPop(T &item) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.erase(items_.begin());
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mu_;
+    std::condition_variable ready_;
+    std::vector<T> items_;
+    bool closed_ = false;
+};
+
+// One chunk in flight: its word window plus input and output buffers
+struct PipelineSlot {
+    size_t w = 0;
+    size_t n = 0;
+    std::vector<uint64_t> a, b, out;
+};
+
+struct PipelineStats {
+    double read = 0;
+    double compute = 0;
+    double write = 0;
+};
+
+// Three-stage chunk pipeline: a reader thread fills slots, the calling thread
+// computes and a writer thread drains them in order. `slots` buffers rotate
+// between the stages, so reading chunk k+1 and writing chunk k-1 overlap the
+// compute on chunk k and wall time tends to the slowest stage, not the sum.
+static bool runChunkPipeline(size_t nWords, size_t chunkWords, size_t slots,
+                             const std::function<bool(PipelineSlot &)> &read,
+                             const std::function<void(PipelineSlot &)> &compute,
+                             const std::function<bool(PipelineSlot &)> &write, PipelineStats &stats) {
+    std::vector<PipelineSlot> storage(std::max<size_t>(2, slots));
+    BlockingQueue<PipelineSlot*> freeSlots, loaded, computed;
+    for (auto &slot : storage) freeSlots.push(&slot);
+    std::atomic<bool> failed{false};
+
+    std::thread reader([&] {
+        PipelineSlot *slot;
+        for (size_t w = 0; w < nWords && !failed && freeSlots.pop(slot); w += chunkWords) {
+            auto t = std::chrono::steady_clock::now();
+            slot->w = w;
+            slot->n = std::min(chunkWords, nWords - w);
+            if (!read(*slot)) failed = true;
+            stats.read += secsSince(t);
+            loaded.push(slot);
+        }
+        loaded.close();
+    });
+    std::thread writer([&] {
+        PipelineSlot *slot;
+        while (computed.pop(slot)) {
+            auto t = std::chrono::steady_clock::now();
+            if (!failed && !write(*slot)) failed = true;
+            stats.write += secsSince(t);
+            freeSlots.push(slot);
+        }
+        freeSlots.close(); // unblocks the reader if it stopped early
+    });
+
+    PipelineSlot *slot;
+    while (loaded.pop(slot)) {
+        auto t = std::chrono::steady_clock::now();
+        if (!failed) compute(*slot);
+        stats.compute += secsSince(t);
+        computed.push(slot);
+    }
+    computed.close();
+    reader.join();
+    writer.join();
+    return !failed;
+}
+
+// Sequential writer for bit streams in one of the on-disk encodings. Every
+// write() except the last must cover a whole number of words.
+enum class BitFormat { PackedRecord, Binary };
+
+class BitStreamWriter {
+public:
+    bool open(const fs::path &path, BitFormat format) {
+        format_ = format;
+        bits_ = 0;
+        checksum_ = kChecksumSeed;
+        out_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out_.is_open()) return false;
+        if (format_ == BitFormat::PackedRecord) {
+            const RecordHeader hdr = makeRecordHeader(0, 0); // patched by close()
+            out_.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        }
+        return static_cast<bool>(out_);
+    }
+
+    bool write(const uint64_t *words, size_t nBits) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(words);
+        const size_t n = (nBits + 7) / 8;
+        if (format_ == BitFormat::PackedRecord) checksum_ = recordChecksum(bytes, n, checksum_);
+        out_.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(n));
+        bits_ += nBits;
+        return static_cast<bool>(out_);
+    }
+
+    bool close() {
+        if (format_ == BitFormat::PackedRecord && out_.is_open()) {
+            const RecordHeader hdr = makeRecordHeader(bits_, checksum_);
+            out_.seekp(0, std::ios::beg);
+            out_.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        }
+        const bool ok = static_cast<bool>(out_);
+        out_.close();
+        return ok;
+    }
+
+    uint64_t bitsWritten() const { return bits_; }
+
+private:
+    std::ofstream out_;
+    BitFormat format_ = BitFormat::Binary;
+    uint64_t bits_ = 0;
+    uint64_t checksum_ = kChecksumSeed;
+};
+
+// Write packed bits to a binary file; the packed bytes already are the video
+static bool writeBitsAsBinaryVideo(const fs::path &outPath, const BitVector &bits) {
+    BitStreamWriter out;
+    return out.open(outPath, BitFormat::Binary) && out.write(bits.words(), bits.size()) && out.close();
+}
+
+// Pack a mapped '0'/'1' text record (path names it in errors) chunk by chunk,
+// writing the packed bytes to out, or only measuring them if out is null. The
+// checksum is what recordChecksum over the whole packed payload gives, so
+// imported records and catalog entries always agree.
+static bool packTextRecord(const MappedFile &in, const fs::path &path, std::ostream *out, uint64_t &bitLength,
+                           uint64_t &checksum) {
+    const size_t chunkChars = 8 << 20; // 8M chars -> 1 MB of packed bytes
+    const char *text = reinterpret_cast<const char*>(in.data());
+    std::vector<unsigned char> bytes(chunkChars / 8 + 16);
+    size_t pending = 0; // packed bytes not yet flushed
+    checksum = kChecksumSeed;
+    TextBitPacker packer;
+    for (size_t off = 0; off < in.size(); off += chunkChars) {
+        const size_t n = std::min(chunkChars, in.size() - off);
+        pending += packer.pack(text + off, n, bytes.data() + pending);
+        if (!textParseOk(packer, path)) return false;
+        // Keep checksum chunks word-aligned so chaining matches recordChecksum over the whole payload
+        const size_t flush = pending - pending % 8;
+        checksum = recordChecksum(bytes.data(), flush, checksum);
+        if (out) out->write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(flush));
+        std::memmove(bytes.data(), bytes.data() + flush, pending - flush);
+        pending -= flush;
+        in.release(off, n);
+    }
+    pending += packer.finish(bytes.data() + pending);
+    bitLength = packer.bitLength();
+    checksum = recordChecksum(bytes.data(), pending, checksum);
+    if (out) out->write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(pending));
+    return !out || static_cast<bool>(*out);
+}
+
+// Stream a '0'/'1' text file into a packed record without holding either in memory
+static bool importTextRecord(const fs::path &txtPath, const fs::path &recPath, uint64_t &bitLength) {
+    MappedFile in;
+    if (!in.open(txtPath)) return false;
+    std::ofstream out(recPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    RecordHeader hdr = makeRecordHeader(0, 0);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr)); // patched once the length is known
+    uint64_t checksum = 0;
+    if (!packTextRecord(in, txtPath, &out, bitLength, checksum)) return false;
+
+    hdr = makeRecordHeader(bitLength, checksum);
+    out.seekp(0, std::ios::beg);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    return static_cast<bool>(out);
+}
+
+// List database files in a folder, preferring a packed .rec over the legacy
+// .binary.txt of the same video; order follows the directory listing
+static std::vector<fs::path> discoverRecordFiles(const fs::path &dir) {
+    std::vector<fs::path> files;
+    std::unordered_map<std::string, size_t> byName;
+    for (auto &p : fs::directory_iterator(dir)) {
+        if (!p.is_regular_file()) continue;
+        auto name = p.path().filename().string();
+        const bool packed = hasSuffix(name, kRecordSuffix);
+        if (!packed && !hasSuffix(name, kTextSuffix)) continue;
+        auto it = byName.find(recordDisplayName(name));
+        if (it == byName.end()) {
+            byName.emplace(recordDisplayName(name), files.size());
+            files.push_back(p.path().filename()); // store filename only
+        } else if (packed) {
+            files[it->second] = p.path().filename();
+        }
+    }
+    return files;
+}
+
+// Persistent per-folder catalog (catalog.pirc): a 64-byte header, one fixed
+// 64-byte entry per record ordered by video name (the file name without its
+// .rec / .binary.txt suffix, so replicas holding the same videos in different
+// forms agree on record i), then the records' file names. It is built once
+// from the directory and mapped on startup, so resolving record i
+// is a single array access and startup does not walk the folder. The catalog
+// is rebuilt when the folder has changed since it was written (the folder's
+// mtime is newer than the catalog's), when a record's size or length no longer
+// matches its entry, and after import / ingest. A rebuild that cannot be
+// written back (read-only folder) is used from memory.
+static const char kCatalogMagic[8] = {'P', 'I', 'R', 'C', 'A', 'T', '0', '1'};
+static const uint32_t kCatalogVersion = 2;
+static const char *kCatalogFile = "catalog.pirc";
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t count;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint8_t reserved[24];
+};
+static_assert(sizeof(CatalogHeader) == 64, "CatalogHeader is part of the on-disk format");
+
+struct CatalogEntry {
+    uint64_t id;
+    uint64_t nameOffset; // into the name table
+    uint64_t nameLength;
+    uint64_t payloadOffset; // where the packed bits start in the file (0 for text records)
+    uint64_t bitLength;
+    uint64_t checksum; // recordChecksum of the packed payload
+    uint64_t fileSize;
+    uint64_t reserved;
+};
+static_assert(sizeof(CatalogEntry) == 64, "CatalogEntry is part of the on-disk format");
+
+// Bit length and checksum of a text record, packed chunk by chunk
+static bool scanTextRecord(const fs::path &path, uint64_t &bitLength, uint64_t &checksum) {
+    MappedFile in;
+    return in.open(path) && packTextRecord(in, path, nullptr, bitLength, checksum);
+}
+
+// Walk a folder once and lay out its catalog in memory
+static bool catalogImage(const fs::path &dir, std::vector<unsigned char> &image) {
+    std::vector<fs::path> files = discoverRecordFiles(dir);
+    std::sort(files.begin(), files.end(), [](const fs::path &a, const fs::path &b) {
+        return recordDisplayName(a.string()) < recordDisplayName(b.string());
+    });
+    std::vector<CatalogEntry> entries;
+    std::string names;
+    for (const auto &f : files) {
+        CatalogEntry e{};
+        e.id = entries.size();
+        e.nameOffset = names.size();
+        e.nameLength = f.string().size();
+        names += f.string();
+        const fs::path path = dir / f;
+        e.fileSize = fs::file_size(path);
+        MappedFile map;
+        RecordHeader hdr;
+        if (map.open(path) && parseRecordHeader(map, hdr)) {
+            e.payloadOffset = sizeof(RecordHeader);
+            e.bitLength = hdr.bitLength;
+            e.checksum = hdr.checksum;
+        } else if (!scanTextRecord(path, e.bitLength, e.checksum)) {
+            std::cout << "[ERROR] Cannot catalog " << path.string() << "\n";
+            return false;
+        }
+        entries.push_back(e);
+    }
+
+    CatalogHeader hdr{};
+    std::memcpy(hdr.magic, kCatalogMagic, sizeof(kCatalogMagic));
+    hdr.version = kCatalogVersion;
+    hdr.entrySize = sizeof(CatalogEntry);
+    hdr.count = entries.size();
+    hdr.namesOffset = sizeof(CatalogHeader) + entries.size() * sizeof(CatalogEntry);
+    hdr.namesBytes = names.size();
+    image.resize(hdr.namesOffset + hdr.namesBytes);
+    std::memcpy(image.data(), &hdr, sizeof(hdr));
+    if (!entries.empty()) std::memcpy(image.data() + sizeof(hdr), entries.data(), entries.size() * sizeof(CatalogEntry));
+    if (!names.empty()) std::memcpy(image.data() + hdr.namesOffset, names.data(), names.size());
+    return true;
+}
+
+// Write a catalog image as dir's catalog (to a temporary name, then renamed)
+static bool writeCatalog(const fs::path &dir, const std::vector<unsigned char> &image) {
+    const fs::path path = dir / kCatalogFile;
+    const fs::path tmpPath = path.string() + ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (!out) {
+            out.close();
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    fs::rename(tmpPath, path, ec);
+    if (ec) return false;
+    // The rename bumped the folder's mtime; stamp the catalog after it so it reads as fresh
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+static bool buildCatalog(const fs::path &dir) {
+    std::vector<unsigned char> image;
+    return catalogImage(dir, image) && writeCatalog(dir, image);
+}
+
+class Catalog {
+public:
+    // Map dir's catalog, building or rebuilding it first if missing or stale
+    bool open(const fs::path &dir) {
+        dir_ = dir;
+        const fs::path path = dir / kCatalogFile;
+        std::error_code ec;
+        const bool stale = !fs::exists(path, ec) || fs::last_write_time(dir, ec) > fs::last_write_time(path, ec);
+        if (!stale && map() && filesMatch()) return true;
+        return rebuild();
+    }
+
+    // Catalog the folder again, e.g. after a record was found to disagree with
+    // its entry; kept in memory if it cannot be written back
+    bool rebuild() {
+        auto start = std::chrono::steady_clock::now();
+        map_.close();
+        image_.clear();
+        std::vector<unsigned char> image;
+        if (!catalogImage(dir_, image)) return false;
+        const fs::path path = dir_ / kCatalogFile;
+        if (writeCatalog(dir_, image) && map()) {
+            std::cout << "[OK] Cataloged " << size() << " records in " << path.string() << " (" << secsSince(start) << " seconds)\n";
+            return true;
+        }
+        std::cout << "[WARN] Cannot write " << path.string() << "; using the rebuilt catalog from memory\n";
+        image_ = std::move(image);
+        return adopt(image_.data(), image_.size());
+    }
+
+    size_t size() const { return static_cast<size_t>(header_.count); }
+    const CatalogEntry &entry(size_t id) const {
+        return reinterpret_cast<const CatalogEntry*>(data_ + sizeof(CatalogHeader))[id];
+    }
+    std::string fileName(size_t id) const {
+        const CatalogEntry &e = entry(id);
+        return std::string(reinterpret_cast<const char*>(data_ + header_.namesOffset + e.nameOffset),
+                           static_cast<size_t>(e.nameLength));
+    }
+    std::string name(size_t id) const { return recordDisplayName(fileName(id)); }
+    fs::path path(size_t id) const { return dir_ / fileName(id); }
+
+private:
+    bool map() {
+        if (!map_.open(dir_ / kCatalogFile) || !adopt(map_.data(), map_.size())) {
+            map_.close();
+            return false;
+        }
+        return true;
+    }
+
+    // Validate a catalog image and serve entries from it
+    bool adopt(const unsigned char *data, size_t bytes) {
+        data_ = nullptr;
+        if (!data || bytes < sizeof(CatalogHeader)) return false;
+        std::memcpy(&header_, data, sizeof(header_));
+        if (std::memcmp(header_.magic, kCatalogMagic, sizeof(kCatalogMagic)) != 0 || header_.version != kCatalogVersion ||
+            header_.entrySize != sizeof(CatalogEntry) || header_.namesOffset != sizeof(CatalogHeader) + header_.count * sizeof(CatalogEntry) ||
+            bytes != header_.namesOffset + header_.namesBytes) {
+            return false;
+        }
+        data_ = data;
+        for (size_t i = 0; i < size(); ++i) {
+            if (entry(i).nameOffset + entry(i).nameLength > header_.namesBytes) {
+                data_ = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Rewriting a record in place leaves the folder's mtime alone, so check
+    // every record's size against its entry as well
+    bool filesMatch() const {
+        std::error_code ec;
+        for (size_t i = 0; i < size(); ++i) {
+            if (fs::file_size(path(i), ec) != entry(i).fileSize || ec) return false;
+        }
+        return true;
+    }
+
+    fs::path dir_;
+    MappedFile map_;
+    std::vector<unsigned char> image_; // a rebuilt catalog that could not be written
+    const unsigned char *data_ = nullptr;
+    CatalogHeader header_{};
+};
+
+// Single-file database container (records.pirdb): every record of a folder
+// padded to a fixed stride and interleaved in 4 KB column tiles, so the scan,
+// which takes one tile-column of all records per task, walks the file front
+// to back as one readahead-friendly stream, with one mapping and one
+// descriptor instead of one per record. Layout: a 64-byte header, one
+// CatalogEntry per record (payloadOffset = absolute offset of the record's
+// first tile), the file names, then from the 4 KB-aligned dataOffset tile j of
+// record i at dataOffset + (j * count + i) * 4 KB. The stride is the longest
+// record rounded up to 4 KB; tiles past a record's end are zero (sparse holes).
+// A folder packed into size buckets has one container per bucket instead,
+// records.b<k>.pirdb, each holding the records of one size class (catalog ids
+// ascending) at that class's own stride.
+static const char kContainerMagic[8] = {'P', 'I', 'R', 'D', 'B', '0', '0', '1'};
+static const uint32_t kContainerVersion = 2;
+static const char *kContainerFile = "records.pirdb";
+static const uint64_t kContainerAlign = 4096;
+static const size_t kContainerTile = 4096;
+
+struct ContainerHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t count;
+    uint64_t stride;
+    uint64_t dataOffset;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint32_t bucket; // which of the folder's `buckets` containers this is
+    uint32_t buckets;
+};
+static_assert(sizeof(ContainerHeader) == 64, "ContainerHeader is part of the on-disk format");
+
+class Container {
+public:
+    bool open(const fs::path &path) {
+        path_ = path;
+        auto map = std::make_shared<MappedFile>();
+        if (!map->open(path) || map->size() < sizeof(ContainerHeader)) return false;
+        std::memcpy(&header_, map->data(), sizeof(header_));
+        const ContainerHeader &h = header_;
+        if (std::memcmp(h.magic, kContainerMagic, sizeof(kContainerMagic)) != 0 || h.version != kContainerVersion ||
+            h.entrySize != sizeof(CatalogEntry) || h.namesOffset != sizeof(ContainerHeader) + h.count * sizeof(CatalogEntry) ||
+            h.dataOffset < h.namesOffset + h.namesBytes || h.dataOffset % kContainerAlign != 0 || h.bucket >= h.buckets ||
+            h.stride % kContainerTile != 0 || map->size() != h.dataOffset + h.count * h.stride) {
+            return false;
+        }
+        map_ = map;
+        for (size_t i = 0; i < size(); ++i) {
+            const CatalogEntry &e = entry(i);
+            if (e.nameOffset + e.nameLength > h.namesBytes || e.payloadOffset != h.dataOffset + i * kContainerTile ||
+                (e.bitLength + 7) / 8 > h.stride || (i > 0 && e.id <= entry(i - 1).id)) {
+                map_.reset();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const fs::path &path() const { return path_; }
+    size_t size() const { return static_cast<size_t>(header_.count); }
+    uint64_t stride() const { return header_.stride; }
+    uint32_t bucket() const { return header_.bucket; }
+    uint32_t buckets() const { return header_.buckets; }
+    const CatalogEntry &entry(size_t id) const {
+        return reinterpret_cast<const CatalogEntry*>(map_->data() + sizeof(ContainerHeader))[id];
+    }
+    std::string fileName(size_t id) const {
+        const CatalogEntry &e = entry(id);
+        return std::string(reinterpret_cast<const char*>(map_->data() + header_.namesOffset + e.nameOffset),
+                           static_cast<size_t>(e.nameLength));
+    }
+    RecordView view(size_t id) const {
+        return RecordView::tiled(map_, path_, entry(id).payloadOffset, entry(id).bitLength, kContainerTile, header_.count * kContainerTile);
+    }
+
+private:
+    fs::path path_;
+    std::shared_ptr<const MappedFile> map_;
+    ContainerHeader header_{};
+};
+
+static fs::path containerPath(const fs::path &dir, uint32_t bucket, uint32_t buckets) {
+    return buckets == 1 ? dir / kContainerFile : dir / ("records.b" + std::to_string(bucket) + ".pirdb");
+}
+
+// Open dir's containers if they were built from the current catalog: together
+// they hold every cataloged record once, with the same name, length and
+// checksum. Timestamps are not consulted, so rebuilding an unchanged catalog
+// keeps the containers in use.
+static bool openCurrentContainers(const fs::path &dir, const Catalog &catalog, std::vector<Container> &containers) {
+    containers.clear();
+    std::error_code ec;
+    fs::path first = dir / kContainerFile;
+    if (!fs::exists(first, ec)) first = containerPath(dir, 0, 2);
+    if (!fs::exists(first, ec)) return false;
+    std::vector<bool> seen(catalog.size(), false);
+    bool current = true;
+    for (uint32_t b = 0; current && (b == 0 || b < containers.front().buckets()); ++b) {
+        const fs::path path = b == 0 ? first : containerPath(dir, b, containers.front().buckets());
+        Container c;
+        current = fs::exists(path, ec) && c.open(path) && c.bucket() == b &&
+                  (b == 0 || c.buckets() == containers.front().buckets());
+        for (size_t i = 0; current && i < c.size(); ++i) {
+            const CatalogEntry &e = c.entry(i);
+            const size_t id = static_cast<size_t>(e.id);
+            current = id < catalog.size() && !seen[id] && c.fileName(i) == catalog.fileName(id) &&
+                      e.bitLength == catalog.entry(id).bitLength && e.checksum == catalog.entry(id).checksum;
+            if (current) seen[id] = true;
+        }
+        if (current) containers.push_back(std::move(c));
+    }
+    current = current && std::find(seen.begin(), seen.end(), false) == seen.end();
+    if (!current) {
+        std::cout << "[WARN] " << first.string() << " is out of date; reading record files (run 'pack' to rebuild)\n";
+        containers.clear();
+    }
+    return current;
+}
+
+// One replica as the XOR PIR scan sees it: records in catalog (name) order, each
+// logically zero-padded to the longest record so every answer has the same
+// size. Records are mapped, not read, so loading is independent of their size.
+// A replica packed into size buckets is answered one bucket at a time: a query
+// selects among the records of one bucket and its answer is padded only to
+// that bucket's longest record. Unbucketed replicas are a single bucket.
+struct PirRecord {
+    std::string name;
+    fs::path path;
+    uint64_t bitLength = 0;
+    std::shared_ptr<const RecordView> view;
+    size_t bucket = 0;
+    size_t slot = 0; // position among the bucket's records
+};
+
+struct PirBucket {
+    std::vector<size_t> records; // record indices in slot order
+    uint64_t maxBits = 0;
+};
+
+struct PirDatabase {
+    fs::path dir;
+    std::vector<PirRecord> records;
+    std::vector<PirBucket> buckets;
+    uint64_t maxBits = 0;
+    IoBackend io = IoBackend::Mmap;
+    unsigned ioDepth = 64;
+    size_t tileWords = 0; // records interleaved in tiles of this many words (containers)
+#ifndef _WIN32
+    std::shared_ptr<ScanReaders> readers; // direct I/O only; shared with bucket views
+#endif
+
+    size_t recordWords() const { return static_cast<size_t>((maxBits + 63) / 64); }
+};
+
+static bool loadPirDatabase(const fs::path &dir, PirDatabase &db, const StreamConfig &cfg) {
+    db = PirDatabase();
+    db.dir = dir;
+#ifndef _WIN32
+    db.io = cfg.io;
+    db.ioDepth = cfg.ioDepth;
+    if (db.io != IoBackend::Mmap) db.readers = std::make_shared<ScanReaders>(db.io, db.ioDepth);
+#endif
+    if (!fs::exists(dir)) {
+        std::cout << "\xE2\x9D\x8C " << dir.string() << " folder not found!\n";
+        return false;
+    }
+    Catalog catalog;
+    if (!catalog.open(dir)) {
+        std::cout << "[ERROR] Cannot read the catalog of " << dir.string() << "\n";
+        return false;
+    }
+    std::vector<Container> containers;
+    if (openCurrentContainers(dir, catalog, containers)) {
+        db.tileWords = kContainerTile / 8;
+        db.records.resize(catalog.size());
+        db.buckets.resize(containers.size());
+        for (size_t b = 0; b < containers.size(); ++b) {
+            const Container &c = containers[b];
+#ifndef _WIN32
+            std::shared_ptr<DirectFile> direct;
+            if (db.io != IoBackend::Mmap) {
+                direct = std::make_shared<DirectFile>();
+                if (!direct->open(c.path())) direct.reset();
+            }
+#endif
+            for (size_t i = 0; i < c.size(); ++i) {
+                const size_t id = static_cast<size_t>(c.entry(i).id);
+                auto view = std::make_shared<RecordView>(c.view(i));
+#ifndef _WIN32
+                if (direct) view->enableDirectReads(direct);
+#endif
+                db.records[id] = {catalog.name(id), c.path(), view->bitLength(), view, b, i};
+                db.buckets[b].records.push_back(id);
+                db.buckets[b].maxBits = std::max(db.buckets[b].maxBits, view->bitLength());
+            }
+            db.maxBits = std::max(db.maxBits, db.buckets[b].maxBits);
+        }
+        if (containers.size() == 1) {
+            std::cout << "[OK] " << dir.string() << ": " << catalog.size() << " records from " << kContainerFile << " ("
+                      << containers.front().stride() / 1024 << " KB stride)\n";
+        } else {
+            std::cout << "[OK] " << dir.string() << ": " << catalog.size() << " records in " << containers.size()
+                      << " size buckets (" << containers.front().stride() / 1024 << " to " << containers.back().stride() / 1024
+                      << " KB strides)\n";
+        }
+        return !db.records.empty();
+    }
+    db.buckets.resize(1);
+    bool rebuilt = false;
+    for (size_t i = 0; i < catalog.size(); ++i) {
+        const fs::path path = catalog.path(i);
+        auto view = std::make_shared<RecordView>();
+        if (!view->open(path) || view->bitLength() != catalog.entry(i).bitLength) {
+            // A record rewritten since cataloging: catalog the folder again, once
+            if (rebuilt) {
+                std::cout << "[ERROR] Failed to open " << path.string() << " as cataloged\n";
+                return false;
+            }
+            std::cout << "[WARN] " << path.string() << " changed since it was cataloged; recataloging " << dir.string() << "\n";
+            if (!catalog.rebuild()) return false;
+            rebuilt = true;
+            db.records.clear();
+            db.buckets[0].records.clear();
+            db.maxBits = 0;
+            i = SIZE_MAX; // restart at 0
+            continue;
+        }
+#ifndef _WIN32
+        if (db.io != IoBackend::Mmap) view->enableDirectReads();
+#endif
+        db.records.push_back({catalog.name(i), path, view->bitLength(), view, 0, i});
+        db.buckets[0].records.push_back(i);
+        db.maxBits = std::max(db.maxBits, view->bitLength());
+    }
+    db.buckets[0].maxBits = db.maxBits;
+    return !db.records.empty();
+}
+
+static std::vector<fs::path> setup_server_database() {
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Setting up server database...\n";
+
+    fs::path d0 = fs::path("D0");
+    if (!fs::exists(d0)) {
+        std::cout << "\xE2\x9D\x8C D0 folder not found!\n";
+        return {};
+    }
+
+    Catalog catalog;
+    if (!catalog.open(d0)) {
+        std::cout << "\xE2\x9D\x8C Cannot read the D0 catalog!\n";
+        return {};
+    }
+    std::vector<fs::path> videoFiles;
+    for (size_t i = 0; i < catalog.size(); ++i) videoFiles.push_back(catalog.fileName(i));
+
+    if (videoFiles.empty()) {
+        std::cout << "\xE2\x9D\x8C No videos found in D0 folder!\n";
+        return {};
+    }
+
+    std::cout << "\xE2\x9C\x85 Server has " << videoFiles.size() << " videos:\n";
+    for (size_t i = 0; i < videoFiles.size(); ++i) {
+        auto videoName = recordDisplayName(videoFiles[i].filename().string());
+        std::cout << "  " << i << ": " << videoName << "\n";
+    }
+
+    std::cout << "[TIME] Setup completed in " << secsSince(start) << " seconds\n";
+    return videoFiles;
+}
+
+static BitVector client_generate_query(int targetIndex, size_t total) {
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Client generating query for video " << targetIndex << "...\n";
+    BitVector q(total);
+    if (targetIndex >= 0 && static_cast<size_t>(targetIndex) < total) q.set(static_cast<size_t>(targetIndex), true);
+    std::cout << "[OK] Query vector generated: [";
+    for (size_t i = 0; i < q.size(); ++i) {
+        std::cout << q.get(i) << (i + 1 < q.size() ? ", " : "]\n");
+    }
+    std::cout << "[TIME] Query generation took " << secsSince(start) << " seconds\n";
+    return q;
+}
+
+static const char *kServerResponseFile = "server_response.rec";
+
+// Streams D0.r1 + D1.r2 for the selected record into a packed response record
+// chunk by chunk (load -> masks -> combine -> emit), within cfg.memoryLimit
+static bool server_process_query(const BitVector &query, const std::vector<fs::path> &videoFiles,
+                                 const StreamConfig &cfg, ThreadPool &pool, const fs::path &responsePath) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "Server processing query using D0.r1 + D1.r2...\n";
+
+    fs::path d0 = fs::path("D0");
+    fs::path d1 = fs::path("D1");
+
+    for (size_t i = 0; i < videoFiles.size(); ++i) {
+        if (i < query.size() && query.get(i)) {
+            const auto &videoFile = videoFiles[i];
+            std::cout << "Processing " << videoFile.filename().string() << "...\n";
+
+            auto loadStart = std::chrono::steady_clock::now();
+            RecordView d0Bits;
+            if (!d0Bits.open(d0 / videoFile)) {
+                std::cout << "Failed to read D0 file\n";
+                return false;
+            }
+    std::cout << "[TIME] Loading D0 took " << secsSince(loadStart) << " seconds\n";
+
+            loadStart = std::chrono::steady_clock::now();
+            RecordView d1Bits;
+            if (!d1Bits.open(d1 / videoFile)) {
+                std::cout << "Failed to read D1 file\n";
+                return false;
+            }
+            std::cout << "[TIME] Loading D1 took " << secsSince(loadStart) << " seconds\n";
+
+            std::cout << "[OK] D0 loaded: " << d0Bits.bitLength() << " bits\n";
+            std::cout << "[OK] D1 loaded: " << d1Bits.bitLength() << " bits\n";
+
+            // Each of the three slots holds D0, D1 and result chunks; r1 and r2 add two more
+            const size_t slots = 3;
+            const size_t chunkWords = cfg.chunkWords(3 * slots + 2);
+            const uint64_t bitLen = d0Bits.bitLength();
+            const MaskPrg::Seed seed = MaskPrg::randomSeed();
+            auto computeStart = std::chrono::steady_clock::now();
+            BitStreamWriter out;
+            if (!out.open(responsePath, BitFormat::PackedRecord)) {
+                std::cout << "[ERROR] Cannot create " << responsePath.string() << "\n";
+                return false;
+            }
+            MaskedCombiner combiner(seed, pool);
+#ifndef _WIN32
+            // Direct I/O: both shares' chunks go out as one batch of block reads
+            std::unique_ptr<BlockReader> reader;
+            std::unique_ptr<RecordFetcher> fetcher;
+            if (cfg.io != IoBackend::Mmap && d0Bits.enableDirectReads() && d1Bits.enableDirectReads()) {
+                reader = makeBlockReader(cfg.io, cfg.ioDepth);
+                fetcher.reset(new RecordFetcher(*reader));
+                std::cout << "[OK] Reading D0 and D1 with " << reader->name() << " direct I/O\n";
+            }
+#endif
+            PipelineStats stats;
+            const bool ok = runChunkPipeline(d0Bits.wordCount(), chunkWords, slots,
+                [&](PipelineSlot &slot) {
+                    slot.a.resize(slot.n);
+                    slot.b.resize(slot.n);
+#ifndef _WIN32
+                    if (fetcher) {
+                        d0Bits.fetchWords(*fetcher, slot.w, slot.n, slot.a.data());
+                        d1Bits.fetchWords(*fetcher, slot.w, slot.n, slot.b.data());
+                        return fetcher->run();
+                    }
+#endif
+                    d0Bits.copyWords(slot.w, slot.n, slot.a.data());
+                    d1Bits.copyWords(slot.w, slot.n, slot.b.data());
+                    d0Bits.release(slot.w, slot.n);
+                    d1Bits.release(slot.w, slot.n);
+                    return true;
+                },
+                [&](PipelineSlot &slot) {
+                    slot.out.resize(slot.n);
+                    combiner.combine(slot.out.data(), slot.a.data(), slot.b.data(), slot.w, slot.n);
+                },
+                [&](PipelineSlot &slot) {
+                    return out.write(slot.out.data(), static_cast<size_t>(std::min<uint64_t>(slot.n * 64, bitLen - slot.w * 64)));
+                },
+                stats);
+            if (!out.close() || !ok) {
+                std::cout << "[ERROR] Failed writing " << responsePath.string() << "\n";
+                return false;
+            }
+            std::cout << "[TIME] Pipeline stages: loading " << stats.read << " s, masks + combine "
+                      << stats.compute << " s, saving " << stats.write << " s\n";
+            std::cout << "[TIME] Generating r1, r2 and computing D0.r1 + D1.r2 took " << secsSince(computeStart) << " seconds\n";
+            std::cout << "[OK] D0.r1 + D1.r2 computed: " << out.bitsWritten() << " bits (" << simdLevelName()
+                      << " kernel, " << chunkWords * 8 / 1024 << " KB chunks) -> " << responsePath.string() << "\n";
+
+            std::cout << "[STEP] Saving mask seed for client decoding...\n";
+            auto saveStart = std::chrono::steady_clock::now();
+            if (!writeMaskSeed(kMaskSeedFile, seed)) {
+                std::cout << "File error saving mask seed. Using simplified approach...\n";
+                fs::remove(kMaskSeedFile); // the client falls back to D0 without a seed
+                return true;
+            }
+            std::cout << "[OK] " << seed.size() << "-byte mask seed saved to " << kMaskSeedFile << "\n";
+            std::cout << "[TIME] Saving mask seed took " << secsSince(saveStart) << " seconds\n";
+
+            std::cout << "[TIME] Server processing completed in " << secsSince(overall) << " seconds\n";
+            return true;
+        }
+    }
+
+    std::cout << "[TIME] Server processing completed in " << secsSince(overall) << " seconds\n";
+    return false;
+}
+
+// Streams the target record into `out` chunk by chunk. With a mask seed, each
+// chunk of the server response is checked against masks regenerated on the fly.
+static bool client_decode_pir_result(const fs::path &responsePath, size_t targetIndex,
+                                     const StreamConfig &cfg, ThreadPool &pool, BitStreamWriter &out) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "Client decoding PIR result for video " << targetIndex << "...\n";
+
+    MaskPrg::Seed seed;
+    const bool haveSeed = readMaskSeed(kMaskSeedFile, seed);
+    RecordView response;
+    if (!haveSeed) {
+        std::cout << "[ERROR] Mask seed not found. Using simplified approach...\n";
+    } else if (!response.open(responsePath)) {
+        std::cout << "[ERROR] Server response not found. Using simplified approach...\n";
+    } else {
+        std::cout << "[OK] Mask seed loaded; r1 and r2 are regenerated on the fly\n";
+    }
+    const bool verify = haveSeed && response.bitLength() > 0;
+
+    // Simplified: return original bits for this demo 
+    std::cout << "[STEP] Decoding PIR result...\n";
+    auto decodeStart = std::chrono::steady_clock::now();
+    Catalog catalog;
+    if (!catalog.open("D0") || targetIndex >= catalog.size()) return false;
+    RecordView original;
+    if (!original.open(catalog.path(targetIndex))) return false;
+    std::cout << "[OK] Original video loaded: " << original.bitLength() << " bits\n";
+
+    // expected, r1, r2 and two staging copies are live per chunk
+    const size_t chunkWords = cfg.chunkWords(5);
+    const size_t nWords = original.wordCount();
+    const uint64_t bitLen = original.bitLength();
+    bool matches = !verify || response.bitLength() == bitLen;
+    MaskedCombiner combiner(seed, pool);
+    std::vector<uint64_t> expected, s0, s1;
+    for (size_t w = 0; w < nWords; w += chunkWords) {
+        const size_t n = std::min(chunkWords, nWords - w);
+        const uint64_t *orig = original.words(w, n, s0);
+        if (verify && matches) {
+            expected.resize(n);
+            combiner.combine(expected.data(), orig, orig, w, n);
+            matches = std::equal(expected.begin(), expected.end(), response.words(w, n, s1));
+            response.release(w, n);
+        }
+        if (!out.write(orig, static_cast<size_t>(std::min<uint64_t>(n * 64, bitLen - w * 64)))) return false;
+        original.release(w, n);
+    }
+    if (verify) {
+        std::cout << (matches ? "[OK] Server response matches the regenerated masks\n"
+                              : "[ERROR] Server response does not match the regenerated masks\n");
+    }
+    std::cout << "[TIME] Decoding took " << secsSince(decodeStart) << " seconds\n";
+    std::cout << "[TIME] Client decoding completed in " << secsSince(overall) << " seconds\n";
+    return true;
+}
+
+static bool convert_bits_to_video_direct(const BitVector &decodedBits) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "[STEP] Converting bits directly to video file...\n";
+    auto convertStart = std::chrono::steady_clock::now();
+    if (!writeBitsAsBinaryVideo("reconstructed_video.mp4", decodedBits)) return false;
+    std::cout << "[OK] Video reconstructed and saved as: reconstructed_video.mp4\n";
+    std::cout << "[TIME] Converting bits to video took " << secsSince(convertStart) << " seconds\n";
+
+#ifdef _WIN32
+    std::cout << "[PLAY] Playing reconstructed video...\n";
+    ShellExecuteA(nullptr, "open", "reconstructed_video.mp4", nullptr, nullptr, SW_SHOWNORMAL);
+#endif
+    std::cout << "[TIME] Direct video conversion completed in " << secsSince(overall) << " seconds\n";
+    return true;
+}
+
+// Decoded chunks are packed bytes already, so they go straight into the video
+// file: one write pass, no intermediate text copy of the bits
+static bool client_reconstruct_video(const fs::path &responsePath, size_t targetIndex, const StreamConfig &cfg,
+                                     ThreadPool &pool) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "Client reconstructing video " << targetIndex << "...\n";
+
+    std::cout << "[STEP] Decoding straight to video file...\n";
+    auto decodeStart = std::chrono::steady_clock::now();
+    BitStreamWriter videoOut;
+    if (!videoOut.open("reconstructed_video.mp4", BitFormat::Binary)) {
+        std::cout << "[ERROR] Cannot create reconstructed_video.mp4\n";
+        return false;
+    }
+    if (!client_decode_pir_result(responsePath, targetIndex, cfg, pool, videoOut) || !videoOut.close()) {
+        std::cout << "[ERROR] Error reconstructing video\n";
+        return false;
+    }
+    std::cout << "[OK] Video reconstructed and saved as: reconstructed_video.mp4\n";
+    std::cout << "[TIME] Decoding to video took " << secsSince(decodeStart) << " seconds\n";
+
+#ifdef _WIN32
+    std::cout << "[PLAY] Playing reconstructed video...\n";
+    ShellExecuteA(nullptr, "open", "reconstructed_video.mp4", nullptr, nullptr, SW_SHOWNORMAL);
+#endif
+    std::cout << "[TIME] Video reconstruction completed in " << secsSince(overall) << " seconds\n";
+    return true;
+}
+
+// Two-server XOR PIR: server 0 and server 1 each get a share of the target's
+// unit vector, select the records their share marks and return the XOR of
+// those records; the two answers differ by exactly the target record.
+// Subset queries send a uniformly random subset S and S with the target
+// flipped (information-theoretic, N bits each); DPF queries send the two keys
+// of a point function at the target (O(log N) bytes each).
+enum class QueryKind : uint8_t { Subset = 0, Dpf = 1 };
+
+struct XorPirQuery {
+    QueryKind kind = QueryKind::Dpf;
+    std::vector<unsigned char> forServer[2];
+};
+
+static XorPirQuery client_generate_xor_query(size_t targetIndex, size_t total, QueryKind kind) {
+    auto start = std::chrono::steady_clock::now();
+    std::cout << "Client generating " << (kind == QueryKind::Dpf ? "DPF" : "subset")
+              << " query for video " << targetIndex << "...\n";
+    XorPirQuery q;
+    q.kind = kind;
+    if (kind == QueryKind::Dpf) {
+        DpfKey k0, k1;
+        dpfGenerate(targetIndex, dpfDepthFor(total), k0, k1);
+        q.forServer[0] = k0.serialize();
+        q.forServer[1] = k1.serialize();
+    } else {
+        BitVector subset(total);
+        MaskPrg(MaskPrg::randomSeed(), 0).fill(subset.words(), 0, subset.wordCount());
+        subset.clearTail();
+        q.forServer[0].assign(subset.bytes(), subset.bytes() + subset.byteSize());
+        subset.set(targetIndex, !subset.get(targetIndex));
+        q.forServer[1].assign(subset.bytes(), subset.bytes() + subset.byteSize());
+    }
+    std::cout << "[OK] Query generated: 2 x " << q.forServer[0].size() << " bytes\n";
+    std::cout << "[TIME] Query generation took " << secsSince(start) << " seconds\n";
+    return q;
+}
+
+// Turn one server's share of the query into a selection bit per record
+static bool server_expand_query(QueryKind kind, const std::vector<unsigned char> &share, size_t total,
+                                ThreadPool &pool, BitVector &selection) {
+    auto start = std::chrono::steady_clock::now();
+    if (kind == QueryKind::Dpf) {
+        DpfKey key;
+        if (!DpfKey::deserialize(share.data(), share.size(), key) || (total > (static_cast<uint64_t>(1) << key.depth))) {
+            std::cout << "[ERROR] Malformed DPF key\n";
+            return false;
+        }
+        selection = dpfEvalFull(key, total, pool);
+        std::cout << "[TIME] DPF expansion over " << total << " records took " << secsSince(start) << " seconds\n";
+        return true;
+    }
+    selection = BitVector(total);
+    if (share.size() != selection.byteSize()) {
+        std::cout << "[ERROR] Subset query has the wrong length\n";
+        return false;
+    }
+    std::memcpy(selection.bytes(), share.data(), share.size());
+    selection.clearTail();
+    return true;
+}
+
+// Answers a batch of K queries in one pass over the database: answer q is the
+// XOR of every record selected by selections[q]. The padded record width is cut
+// into column slices and the records selected by any query into groups; each
+// (slice, group) task loads its records' slice once and XORs it into the
+// worker's partial accumulator of every query that selects the record, so the
+// slice is reused K times while it is still in cache. Slices shrink as K grows
+// to keep all K partials around 1 MB; on a container the slice is one tile, so
+// a task's rows are adjacent in the file. Tasks are ordered slice-major so a
+// worker mostly stays on one slice (and container scans run through the file
+// in order), and it folds its partials into the answers whenever it moves on
+// and once more at the end. A failed read abandons the pass and yields no answers.
+static std::vector<BitVector> server_answer_xor_batch(const PirDatabase &db, const std::vector<BitVector> &selections,
+                                                      ThreadPool &pool) {
+    auto start = std::chrono::steady_clock::now();
+    const size_t batch = selections.size();
+    std::cout << "Server " << db.dir.string() << " answering " << batch << " XOR PIR quer"
+              << (batch == 1 ? "y" : "ies") << "...\n";
+
+    std::vector<size_t> selected;
+    size_t selectedPairs = 0;
+    for (size_t i = 0; i < db.records.size(); ++i) {
+        size_t hits = 0;
+        for (const auto &sel : selections) hits += i < sel.size() && sel.get(i);
+        if (hits) selected.push_back(i);
+        selectedPairs += hits;
+    }
+    const size_t words = db.recordWords();
+    const size_t sliceWords = db.tileWords ? db.tileWords
+                                           : std::max<size_t>(512, (size_t(1) << 17) / std::max<size_t>(1, batch) / 8 * 8);
+    const size_t slices = std::max<size_t>(1, (words + sliceWords - 1) / sliceWords);
+    const size_t wantTasks = 4 * static_cast<size_t>(pool.size());
+    const size_t groups = std::max<size_t>(1, std::min(selected.size(), (wantTasks + slices - 1) / slices));
+    const size_t perGroup = (selected.size() + groups - 1) / std::max<size_t>(1, groups);
+
+    std::vector<BitVector> answers(batch, BitVector(static_cast<size_t>(db.maxBits)));
+    // Records are folded rowBlock at a time as one K x rowBlock GF(2) product
+    const size_t rowBlock = std::max<size_t>(16, std::min<size_t>(64, (size_t(2) << 20) / std::max<size_t>(1, sliceWords) / 8 * 8));
+    struct Partial {
+        size_t slice = SIZE_MAX;
+        std::vector<uint64_t> acc, buf; // acc holds K partials of the slice back to back
+        std::vector<std::vector<uint64_t>> staging; // zero-padded rows past a record's end
+        std::vector<const uint64_t*> rows;
+        std::vector<size_t> rowRecords;
+        std::vector<uint8_t> sel;
+        Gf2MatMul mm;
+    };
+    std::vector<Partial> partials(pool.size());
+#ifndef _WIN32
+    if (db.readers) db.readers->reserve(pool.size());
+#endif
+    std::vector<std::mutex> sliceLocks(slices);
+    std::atomic<bool> failed{false};
+    auto flush = [&](Partial &p) {
+        if (p.slice == SIZE_MAX) return;
+        const size_t begin = p.slice * sliceWords, n = std::min(sliceWords, words - begin);
+        std::lock_guard<std::mutex> lock(sliceLocks[p.slice]);
+        for (size_t q = 0; q < batch; ++q) xorInto(answers[q].words() + begin, p.acc.data() + q * n, n);
+        p.slice = SIZE_MAX;
+    };
+    // Fold the gathered rows (p.rows, from records p.rowRecords) into the K partials
+    auto fold = [&](Partial &p, size_t n) {
+        const size_t count = p.rows.size(), stride = (count + 7) / 8;
+        p.sel.assign(batch * stride, 0);
+        for (size_t q = 0; q < batch; ++q) {
+            for (size_t j = 0; j < count; ++j) {
+                const size_t record = p.rowRecords[j];
+                if (record < selections[q].size() && selections[q].get(record)) {
+                    p.sel[q * stride + j / 8] |= static_cast<uint8_t>(1u << (j % 8));
+                }
+            }
+        }
+        p.mm.multiply(p.rows.data(), count, n, p.sel.data(), batch, p.acc.data(), n);
+        p.rows.clear();
+        p.rowRecords.clear();
+    };
+
+    pool.run(slices * groups, [&](size_t task, unsigned worker) {
+        if (failed) return;
+        const size_t slice = task / groups, group = task % groups;
+        const size_t begin = slice * sliceWords, n = std::min(sliceWords, words - begin);
+        Partial &p = partials[worker];
+        if (p.slice != slice) {
+            flush(p);
+            p.acc.assign(batch * n, 0);
+            p.slice = slice;
+        }
+        const size_t first = group * perGroup, last = std::min(selected.size(), first + perGroup);
+#ifndef _WIN32
+        if (db.readers) {
+            // Keep a block of records' slices in flight at once, then fold them
+            RecordFetcher &fetcher = db.readers->fetcher(worker);
+            p.buf.resize(rowBlock * n);
+            auto fetchAndFold = [&] {
+                if (!fetcher.run()) return false;
+                fold(p, n);
+                return true;
+            };
+            for (size_t k = first; k < last; ++k) {
+                const PirRecord &rec = db.records[selected[k]];
+                if (begin * 64 >= rec.bitLength) continue; // only padding in this slice
+                uint64_t *row = p.buf.data() + p.rows.size() * n;
+                rec.view->fetchWords(fetcher, begin, n, row);
+                p.rows.push_back(row);
+                p.rowRecords.push_back(selected[k]);
+                if (p.rows.size() == rowBlock && !fetchAndFold()) {
+                    failed = true;
+                    return;
+                }
+            }
+            if (!p.rows.empty() && !fetchAndFold()) failed = true;
+            return;
+        }
+#endif
+        p.staging.resize(rowBlock);
+        for (size_t k = first; k < last; ++k) {
+            const PirRecord &rec = db.records[selected[k]];
+            if (begin * 64 >= rec.bitLength) continue; // only padding in this slice
+            p.rows.push_back(rec.view->words(begin, n, p.staging[p.rows.size()]));
+            p.rowRecords.push_back(selected[k]);
+            if (p.rows.size() == rowBlock) fold(p, n);
+        }
+        if (!p.rows.empty()) fold(p, n);
+    });
+    if (failed) {
+        std::cout << "[ERROR] Direct read failed in " << db.dir.string() << "\n";
+        return {};
+    }
+    for (auto &p : partials) flush(p);
+
+    const double secs = secsSince(start);
+    uint64_t scannedBits = 0, answeredBits = 0;
+    for (size_t i : selected) scannedBits += db.records[i].bitLength;
+    for (size_t i = 0; i < db.records.size(); ++i) {
+        for (const auto &sel : selections) {
+            if (i < sel.size() && sel.get(i)) answeredBits += db.records[i].bitLength;
+        }
+    }
+    std::cout << "[OK] XORed " << selected.size() << "/" << db.records.size() << " records into " << batch
+              << " answer" << (batch == 1 ? "" : "s") << " (" << selectedPairs << " record selections) as "
+              << slices << "x" << groups << " tasks on " << pool.size() << " threads (" << simdLevelName() << " kernel";
+    if (Gf2MatMul::groupBits(batch)) std::cout << ", Four Russians with " << Gf2MatMul::groupBits(batch) << "-row tables";
+    std::cout << ")\n";
+    std::cout << "[TIME] Answer took " << secs << " seconds (" << (secs > 0 ? scannedBits / 8 / secs / 1e6 : 0.0)
+              << " MB/s scanned, " << (secs > 0 ? answeredBits / 8 / secs / 1e6 : 0.0) << " MB/s answered)\n";
+    return answers;
+}
+
+static BitVector server_answer_xor_query(const PirDatabase &db, const BitVector &selection, ThreadPool &pool) {
+    std::vector<BitVector> answers = server_answer_xor_batch(db, {selection}, pool);
+    return answers.empty() ? BitVector() : std::move(answers.front());
+}
+
+// Size bucket b of db as a database of its own: the bucket's records in slot
+// order, padded only to the bucket's longest record. Views are shared.
+static PirDatabase bucketDatabase(const PirDatabase &db, size_t b) {
+    PirDatabase sub;
+    sub.dir = db.dir;
+    sub.io = db.io;
+    sub.ioDepth = db.ioDepth;
+    sub.tileWords = db.tileWords;
+#ifndef _WIN32
+    sub.readers = db.readers;
+#endif
+    sub.maxBits = db.buckets[b].maxBits;
+    sub.buckets.resize(1);
+    sub.buckets[0].maxBits = sub.maxBits;
+    for (size_t id : db.buckets[b].records) {
+        PirRecord rec = db.records[id];
+        rec.bucket = 0;
+        rec.slot = sub.records.size();
+        sub.buckets[0].records.push_back(sub.records.size());
+        sub.records.push_back(std::move(rec));
+    }
+    return sub;
+}
+
+static std::vector<PirDatabase> bucketDatabases(const PirDatabase &db) {
+    std::vector<PirDatabase> subs;
+    for (size_t b = 0; b < db.buckets.size(); ++b) subs.push_back(bucketDatabase(db, b));
+    return subs;
+}
+
+// Answer queries that each select among the records of one bucket: one batched
+// pass over each bucket that has queries, so a query costs a scan of its own
+// bucket rather than of the whole database. Empty if any pass failed.
+static std::vector<BitVector> server_answer_xor_buckets(const std::vector<PirDatabase> &buckets,
+                                                        const std::vector<size_t> &bucketOf,
+                                                        const std::vector<BitVector> &selections, ThreadPool &pool) {
+    std::vector<BitVector> answers(selections.size());
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        std::vector<BitVector> group;
+        std::vector<size_t> owners;
+        for (size_t q = 0; q < selections.size(); ++q) {
+            if (bucketOf[q] != b) continue;
+            group.push_back(selections[q]);
+            owners.push_back(q);
+        }
+        if (group.empty()) continue;
+        if (buckets.size() > 1) std::cout << "[STEP] Size bucket " << b << " (" << buckets[b].records.size() << " records)\n";
+        std::vector<BitVector> out = server_answer_xor_batch(buckets[b], group, pool);
+        if (out.empty()) return {};
+        for (size_t j = 0; j < owners.size(); ++j) answers[owners[j]] = std::move(out[j]);
+    }
+    return answers;
+}
+
+static BitVector client_decode_xor_answers(const BitVector &answer0, const BitVector &answer1, uint64_t bitLength) {
+    auto start = std::chrono::steady_clock::now();
+    BitVector decoded = answer0;
+    xorInto(decoded.words(), answer1.words(), std::min(decoded.wordCount(), answer1.wordCount()));
+    decoded.resize(static_cast<size_t>(bitLength)); // drop the padding to the longest record
+    std::cout << "[OK] Answers combined: " << decoded.size() << " bits\n";
+    std::cout << "[TIME] Client decoding took " << secsSince(start) << " seconds\n";
+    return decoded;
+}
+
+// Load D0 and D1 and check that they hold the same records, entry by entry
+static bool loadServerReplicas(const StreamConfig &cfg, PirDatabase &db0, PirDatabase &db1) {
+    auto setupStart = std::chrono::steady_clock::now();
+    if (!loadPirDatabase("D0", db0, cfg) || !loadPirDatabase("D1", db1, cfg)) return false;
+    bool same = db0.records.size() == db1.records.size() && db0.maxBits == db1.maxBits &&
+                db0.buckets.size() == db1.buckets.size();
+    for (size_t i = 0; same && i < db0.records.size(); ++i) {
+        const PirRecord &a = db0.records[i], &b = db1.records[i];
+        same = a.name == b.name && a.bitLength == b.bitLength && a.bucket == b.bucket;
+    }
+    if (!same) {
+        std::cout << "\xE2\x9D\x8C D0 and D1 are not replicas of the same database!\n";
+        return false;
+    }
+    std::cout << "\xE2\x9C\x85 Servers have " << db0.records.size() << " videos";
+    if (db0.buckets.size() > 1) std::cout << " in " << db0.buckets.size() << " size buckets";
+    std::cout << ":\n";
+    for (size_t i = 0; i < db0.records.size(); ++i) {
+        std::cout << "  " << i << ": " << db0.records[i].name;
+        if (db0.buckets.size() > 1) std::cout << " (bucket " << db0.records[i].bucket << ")";
+        std::cout << "\n";
+    }
+    std::cout << "[TIME] Setup completed in " << secsSince(setupStart) << " seconds\n";
+    return true;
+}
+
+// Interactive two-server XOR PIR over every record in D0 and D1
+static int run_xor_pir(ThreadPool &pool, QueryKind kind, const StreamConfig &cfg) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "[PIR] Two-server XOR PIR\n";
+    printDivider();
+
+    PirDatabase db0, db1;
+    if (!loadServerReplicas(cfg, db0, db1)) return 0;
+
+    int targetIndex = 0;
+    std::cout << "\nClient: Enter video index to retrieve (0-" << (static_cast<int>(db0.records.size()) - 1) << "): ";
+    if (!(std::cin >> targetIndex)) {
+        std::cin.clear();
+        targetIndex = 0;
+        std::cout << "\xE2\x9D\x8C Invalid input! Using video 0 by default.\n";
+    }
+    if (targetIndex < 0 || static_cast<size_t>(targetIndex) >= db0.records.size()) {
+        std::cout << "\xE2\x9D\x8C Invalid video index!\n";
+        return 0;
+    }
+
+    // The query selects among the records of the target's size bucket only
+    const PirRecord &target = db0.records[static_cast<size_t>(targetIndex)];
+    const PirDatabase bucket0 = bucketDatabase(db0, target.bucket);
+    const PirDatabase bucket1 = bucketDatabase(db1, target.bucket);
+    if (db0.buckets.size() > 1) {
+        std::cout << "[OK] Video " << targetIndex << " is in size bucket " << target.bucket << " ("
+                  << bucket0.records.size() << " records, padded to " << bucket0.maxBits << " bits)\n";
+    }
+    auto query = client_generate_xor_query(target.slot, bucket0.records.size(), kind);
+    BitVector selection0, selection1;
+    if (!server_expand_query(query.kind, query.forServer[0], bucket0.records.size(), pool, selection0) ||
+        !server_expand_query(query.kind, query.forServer[1], bucket1.records.size(), pool, selection1)) {
+        std::cout << "\n[ERROR] PIR Protocol Failed!\n";
+        return 1;
+    }
+    BitVector answer0 = server_answer_xor_query(bucket0, selection0, pool);
+    BitVector answer1 = server_answer_xor_query(bucket1, selection1, pool);
+    if (answer0.empty() || answer1.empty()) {
+        std::cout << "\n[ERROR] PIR Protocol Failed!\n";
+        return 1;
+    }
+    BitVector decoded = client_decode_xor_answers(answer0, answer1, target.bitLength);
+    if (!convert_bits_to_video_direct(decoded)) {
+        std::cout << "\n[ERROR] PIR Protocol Failed!\n";
+        return 1;
+    }
+    std::cout << "\n[DONE] PIR Protocol Completed!\n";
+    std::cout << "[TIME] Total time: " << secsSince(overall) << " seconds\n";
+    return 0;
+}
+
+// K clients' XOR PIR queries answered together: each server expands every
+// query and makes a single pass over its database for the whole batch. The
+// retrieved records are written to outDir under their own names.
+static int run_batch_xor_pir(ThreadPool &pool, QueryKind kind, const StreamConfig &cfg,
+                             const std::vector<std::string> &indexArgs, const fs::path &outDir) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "[PIR] Two-server XOR PIR, batched\n";
+    printDivider();
+
+    PirDatabase db0, db1;
+    if (!loadServerReplicas(cfg, db0, db1)) return 1;
+    std::vector<size_t> targets;
+    for (const auto &a : indexArgs) {
+        size_t idx = 0;
+        try {
+            idx = static_cast<size_t>(std::stoull(a));
+        } catch (const std::exception &) {
+            idx = SIZE_MAX;
+        }
+        if (idx >= db0.records.size()) {
+            std::cout << "\xE2\x9D\x8C Invalid video index: " << a << "\n";
+            return 1;
+        }
+        targets.push_back(idx);
+    }
+    if (targets.empty()) {
+        std::cout << "[ERROR] No video indices given\n";
+        return 1;
+    }
+
+    // Each query selects among its target's size bucket; every bucket with
+    // queries gets one pass for all of them
+    const std::vector<PirDatabase> buckets0 = bucketDatabases(db0), buckets1 = bucketDatabases(db1);
+    std::vector<BitVector> selections0, selections1;
+    std::vector<size_t> bucketOf;
+    for (size_t target : targets) {
+        const PirRecord &rec = db0.records[target];
+        const size_t n = buckets0[rec.bucket].records.size();
+        auto query = client_generate_xor_query(rec.slot, n, kind);
+        BitVector s0, s1;
+        if (!server_expand_query(query.kind, query.forServer[0], n, pool, s0) ||
+            !server_expand_query(query.kind, query.forServer[1], n, pool, s1)) {
+            std::cout << "\n[ERROR] PIR Protocol Failed!\n";
+            return 1;
+        }
+        selections0.push_back(std::move(s0));
+        selections1.push_back(std::move(s1));
+        bucketOf.push_back(rec.bucket);
+    }
+    const std::vector<BitVector> answers0 = server_answer_xor_buckets(buckets0, bucketOf, selections0, pool);
+    const std::vector<BitVector> answers1 = server_answer_xor_buckets(buckets1, bucketOf, selections1, pool);
+    if (answers0.empty() || answers1.empty()) {
+        std::cout << "\n[ERROR] PIR Protocol Failed!\n";
+        return 1;
+    }
+
+    std::error_code ec;
+    fs::create_directories(outDir, ec);
+    for (size_t q = 0; q < targets.size(); ++q) {
+        const PirRecord &rec = db0.records[targets[q]];
+        BitVector decoded = client_decode_xor_answers(answers0[q], answers1[q], rec.bitLength);
+        if (!writeBitsAsBinaryVideo(outDir / rec.name, decoded)) {
+            std::cout << "[ERROR] Cannot write " << (outDir / rec.name).string() << "\n";
+            return 1;
+        }
+        std::cout << "[OK] Query " << q << ": video " << targets[q] << " -> " << (outDir / rec.name).string() << "\n";
+    }
+    std::cout << "\n[DONE] PIR Protocol Completed for " << targets.size() << " queries!\n";
+    std::cout << "[TIME] Total time: " << secsSince(overall) << " seconds\n";
+    return 0;
+}
+
+#ifndef _WIN32
+// PIR daemon wire format (host byte order, like the DPF key encoding): every
+// message is a 24-byte FrameHeader followed by payloadBytes of payload.
+//   Info   request: no payload. Response: count = records; payload = maxBits
+//          (u64), then per record its bit length (u64), name length (u16), name,
+//          then per record its size bucket (u32).
+//   Query  request: count = K shares, kind = QueryKind, bucket = the size
+//          bucket all K shares select from (over its records in catalog
+//          order); payload = K x (u32 length, share bytes). Response: count =
+//          K; payload = answer bit length (u64, the bucket's longest record),
+//          then K packed answers of (bits + 7) / 8 bytes each.
+// A response with a non-zero status carries no payload.
+enum class FrameType : uint8_t { Info = 1, Query = 2 };
+
+static const char kFrameMagic[4] = {'P', 'I', 'R', 'F'};
+static const uint64_t kMaxRequestPayload = uint64_t(64) << 20;
+
+struct FrameHeader {
+    char magic[4];
+    uint8_t type;
+    uint8_t status; // 0 = ok
+    uint8_t kind;
+    uint8_t reserved;
+    uint32_t count;
+    uint32_t bucket;
+    uint64_t payloadBytes;
+};
+static_assert(sizeof(FrameHeader) == 24, "FrameHeader is part of the wire format");
+
+static FrameHeader makeFrameHeader(FrameType type, uint32_t count, uint64_t payloadBytes) {
+    FrameHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kFrameMagic, sizeof(h.magic));
+    h.type = static_cast<uint8_t>(type);
+    h.count = count;
+    h.payloadBytes = payloadBytes;
+    return h;
+}
+
+static bool sendAll(int fd, const void *data, size_t n) {
+    const char *p = static_cast<const char*>(data);
+    while (n > 0) {
+        const ssize_t sent = send(fd, p, n, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        p += sent;
+        n -= static_cast<size_t>(sent);
     }
     return true;
 }
 
-// Write bits as '0'/'1' chars in chunks
-static bool writeBitsFile(const fs::path &path, const std::vector<int> &bits) {
-    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!out.is_open()) return false;
-    const size_t chunkSize = 1000000; // 1M bits at a time
-    std::string buffer;
-    buffer.reserve(chunkSize);
-    size_t i = 0;
-    while (i < bits.size()) {
-        buffer.clear();
-        const size_t end = std::min(bits.size(), i + chunkSize);
-        for (; i < end; ++i) buffer.push_back(bits[i] ? '1' : '0');
-        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+static bool recvAll(int fd, void *data, size_t n) {
+    char *p = static_cast<char*>(data);
+    while (n > 0) {
+        const ssize_t got = recv(fd, p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
     }
     return true;
 }
 
-// Convert vector<int> bits to bytes and write to binary file in chunks
-static bool writeBitsAsBinaryVideo(const fs::path &outPath, const std::vector<int> &bits) {
-    std::ofstream out(outPath, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!out.is_open()) return false;
-    const size_t chunkBits = 1000000; // process 1M bits per chunk
-    size_t i = 0;
-    std::vector<unsigned char> byteBuf;
-    byteBuf.reserve(chunkBits / 8 + 8);
-    while (i < bits.size()) {
-        const size_t end = std::min(bits.size(), i + chunkBits);
-        byteBuf.clear();
-        for (; i < end; i += 8) {
-            unsigned char value = 0;
-            for (int k = 0; k < 8; ++k) {
-                size_t idx = i + static_cast<size_t>(k);
-                int bit = 0;
-                if (idx < end) bit = bits[idx];
-                value |= static_cast<unsigned char>((bit & 1) << (7 - k));
-            }
-            byteBuf.push_back(value);
-        }
-        out.write(reinterpret_cast<const char*>(byteBuf.data()), static_cast<std::streamsize>(byteBuf.size()));
+static bool sendFrame(int fd, const FrameHeader &h, const std::vector<unsigned char> &payload) {
+    return sendAll(fd, &h, sizeof(h)) && (payload.empty() || sendAll(fd, payload.data(), payload.size()));
+}
+
+static bool recvFrame(int fd, FrameHeader &h, std::vector<unsigned char> &payload, uint64_t maxPayload) {
+    if (!recvAll(fd, &h, sizeof(h)) || std::memcmp(h.magic, kFrameMagic, sizeof(h.magic)) != 0 ||
+        h.payloadBytes > maxPayload) {
+        return false;
     }
-    return true;
+    payload.resize(static_cast<size_t>(h.payloadBytes));
+    return payload.empty() || recvAll(fd, payload.data(), payload.size());
 }
 
-// Read text bits from file and convert to binary video
-static bool convertBitsFileToBinaryVideo(const fs::path &bitsPath, const fs::path &outVideoPath) {
-    std::ifstream in(bitsPath, std::ios::in | std::ios::binary);
-    if (!in.is_open()) return false;
-    std::ofstream out(outVideoPath, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!out.is_open()) return false;
+// Where a daemon listens: a Unix domain socket path, or a loopback TCP port
+struct Endpoint {
+    std::string socketPath;
+    int port = 0;
+
+    std::string describe() const {
+        return socketPath.empty() ? "127.0.0.1:" + std::to_string(port) : socketPath;
+    }
+};
+
+static const unsigned long kMaxPort = 65535;
 
-    std::string bits;
-    in.seekg(0, std::ios::end);
-    bits.resize(static_cast<size_t>(in.tellg()));
-    in.seekg(0, std::ios::beg);
-    in.read(&bits[0], static_cast<std::streamsize>(bits.size()));
-
-    std::vector<unsigned char> bytes;
-    bytes.reserve(bits.size() / 8 + 8);
-    for (size_t i = 0; i < bits.size(); i += 8) {
-        unsigned char value = 0;
-        for (int k = 0; k < 8; ++k) {
-            size_t idx = i + static_cast<size_t>(k);
-            char c = (idx < bits.size() ? bits[idx] : '0');
-            int bit = (c == '1');
-            value |= static_cast<unsigned char>((bit & 1) << (7 - k));
-        }
-        bytes.push_back(value);
-    }
-    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+// "host:port" / ":port" for loopback TCP, anything else is a socket path; false
+// (and reported) when the port is not 1-65535
+static bool parseEndpoint(const std::string &spec, Endpoint &ep) {
+    ep = Endpoint();
+    const size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon + 1 == spec.size() ||
+        spec.find_first_not_of("0123456789", colon + 1) != std::string::npos) {
+        ep.socketPath = spec;
+        return true;
+    }
+    errno = 0;
+    const unsigned long port = std::strtoul(spec.c_str() + colon + 1, nullptr, 10);
+    if (errno == ERANGE || port == 0 || port > kMaxPort) {
+        std::cout << "[ERROR] Invalid port in " << spec << "; expected 1-" << kMaxPort << "\n";
+        return false;
+    }
+    ep.port = static_cast<int>(port);
     return true;
 }
 
-static std::vector<fs::path> setup_server_database() {
-    auto start = std::chrono::steady_clock::now();
-    std::cout << "Setting up server database...\n";
+static int openEndpointSocket(const Endpoint &ep, bool listening) {
+    int fd = -1;
+    int rc = -1;
+    if (!ep.socketPath.empty()) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (ep.socketPath.size() >= sizeof(addr.sun_path)) return -1;
+        std::memcpy(addr.sun_path, ep.socketPath.c_str(), ep.socketPath.size());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) {
+            ::unlink(ep.socketPath.c_str()); // stale socket from an earlier run
+            rc = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        } else {
+            rc = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+    } else {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(ep.port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        const int one = 1;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            rc = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        } else {
+            rc = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        }
+        if (rc == 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (rc == 0 && listening) rc = listen(fd, 64);
+    if (rc != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-    fs::path d0 = fs::path("D0");
-    if (!fs::exists(d0)) {
-        std::cout << "\xE2\x9D\x8C D0 folder not found!\n";
-        return {};
+// Queries waiting for the answering thread; everything queued while a pass is
+// running is answered together in the next single database pass
+struct PendingQuery {
+    QueryKind kind = QueryKind::Dpf;
+    uint32_t bucket = 0;
+    std::vector<std::vector<unsigned char>> shares;
+    std::vector<BitVector> answers;
+    bool ok = false;
+    std::promise<void> done;
+};
+
+class PirServer {
+public:
+    PirServer(const PirDatabase &db, ThreadPool &pool)
+        : db_(db), buckets_(bucketDatabases(db)), pool_(pool), worker_([this] { answerLoop(); }) {}
+
+    ~PirServer() {
+        queue_.close();
+        worker_.join();
     }
 
-    std::vector<fs::path> videoFiles;
-    for (auto &p : fs::directory_iterator(d0)) {
-        if (p.is_regular_file() && p.path().extension() == ".txt") {
-            if (p.path().filename().string().size() >= 12) {
-                // Expecting *.binary.txt
-                auto name = p.path().filename().string();
-                if (name.size() >= 12 && name.substr(name.size() - 11) == ".binary.txt") {
-                    videoFiles.push_back(p.path().filename()); // store filename only
+    // Serve one client connection until it disconnects or misbehaves
+    void serveConnection(int fd) {
+        FrameHeader req;
+        std::vector<unsigned char> payload;
+        while (recvFrame(fd, req, payload, kMaxRequestPayload)) {
+            std::vector<unsigned char> out;
+            FrameHeader resp = makeFrameHeader(static_cast<FrameType>(req.type), 0, 0);
+            if (req.type == static_cast<uint8_t>(FrameType::Info)) {
+                resp.count = static_cast<uint32_t>(db_.records.size());
+                appendPod(out, db_.maxBits);
+                for (const auto &rec : db_.records) {
+                    appendPod(out, rec.bitLength);
+                    appendPod(out, static_cast<uint16_t>(rec.name.size()));
+                    out.insert(out.end(), rec.name.begin(), rec.name.end());
+                }
+                for (const auto &rec : db_.records) appendPod(out, static_cast<uint32_t>(rec.bucket));
+            } else if (req.type == static_cast<uint8_t>(FrameType::Query)) {
+                auto query = parseQuery(req, payload);
+                if (query) {
+                    auto done = query->done.get_future();
+                    queue_.push(query);
+                    done.wait();
                 }
+                if (query && query->ok) {
+                    resp.count = static_cast<uint32_t>(query->answers.size());
+                    resp.bucket = query->bucket;
+                    appendPod(out, buckets_[query->bucket].maxBits);
+                    for (const auto &a : query->answers) out.insert(out.end(), a.bytes(), a.bytes() + a.byteSize());
+                } else {
+                    resp.status = 1;
+                }
+            } else {
+                resp.status = 1;
             }
+            resp.payloadBytes = out.size();
+            if (!sendFrame(fd, resp, out)) break;
         }
+        ::close(fd);
     }
 
-    if (videoFiles.empty()) {
-        std::cout << "\xE2\x9D\x8C No videos found in D0 folder!\n";
-        return {};
+private:
+    template <typename T>
+    static void appendPod(std::vector<unsigned char> &out, const T &v) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(&v);
+        out.insert(out.end(), p, p + sizeof(T));
     }
 
-    std::cout << "\xE2\x9C\x85 Server has " << videoFiles.size() << " videos:\n";
-    for (size_t i = 0; i < videoFiles.size(); ++i) {
-        auto videoName = videoFiles[i].filename().string();
-        if (videoName.size() >= 11) videoName = videoName.substr(0, videoName.size() - 11);
-        std::cout << "  " << i << ": " << videoName << "\n";
+    static std::shared_ptr<PendingQuery> parseQuery(const FrameHeader &req, const std::vector<unsigned char> &payload) {
+        if (req.kind > static_cast<uint8_t>(QueryKind::Dpf) || req.count == 0) return nullptr;
+        auto q = std::make_shared<PendingQuery>();
+        q->kind = static_cast<QueryKind>(req.kind);
+        q->bucket = req.bucket;
+        size_t pos = 0;
+        for (uint32_t i = 0; i < req.count; ++i) {
+            uint32_t len = 0;
+            if (payload.size() - pos < sizeof(len)) return nullptr;
+            std::memcpy(&len, payload.data() + pos, sizeof(len));
+            pos += sizeof(len);
+            if (payload.size() - pos < len) return nullptr;
+            q->shares.emplace_back(payload.begin() + pos, payload.begin() + pos + len);
+            pos += len;
+        }
+        return pos == payload.size() ? q : nullptr;
     }
 
-    std::cout << "[TIME] Setup completed in " << secsSince(start) << " seconds\n";
-    return videoFiles;
+    void answerLoop() {
+        std::shared_ptr<PendingQuery> first;
+        while (queue_.pop(first)) {
+            std::vector<std::shared_ptr<PendingQuery>> batch{first};
+            std::shared_ptr<PendingQuery> more;
+            while (queue_.tryPop(more)) batch.push_back(more);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<BitVector> selections;
+            std::vector<size_t> bucketOf;
+            std::vector<std::pair<size_t, size_t>> owners; // (pending query, share) per selection
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const uint32_t b = batch[i]->bucket;
+                batch[i]->ok = b < buckets_.size();
+                for (size_t k = 0; k < batch[i]->shares.size() && batch[i]->ok; ++k) {
+                    BitVector sel;
+                    batch[i]->ok = server_expand_query(batch[i]->kind, batch[i]->shares[k], buckets_[b].records.size(), pool_, sel);
+                    selections.push_back(std::move(sel));
+                    bucketOf.push_back(b);
+                    owners.push_back({i, k});
+                }
+            }
+            std::vector<BitVector> answers = server_answer_xor_buckets(buckets_, bucketOf, selections, pool_);
+            if (answers.empty() && !selections.empty()) {
+                for (auto &q : batch) q->ok = false; // the pass failed: no query gets a partial XOR
+            }
+            for (size_t j = 0; j < answers.size(); ++j) {
+                PendingQuery &q = *batch[owners[j].first];
+                if (q.ok) q.answers.push_back(std::move(answers[j]));
+            }
+            for (auto &q : batch) q->done.set_value();
+            std::cout << "[TIME] Served " << batch.size() << " request" << (batch.size() == 1 ? "" : "s") << " ("
+                      << selections.size() << " queries) in " << secsSince(start) << " seconds\n";
+        }
+    }
+
+    const PirDatabase &db_;
+    const std::vector<PirDatabase> buckets_;
+    ThreadPool &pool_;
+    BlockingQueue<std::shared_ptr<PendingQuery>> queue_;
+    std::thread worker_;
+};
+
+// Long-running server: load and map one database once, then answer queries
+// from any number of client connections until killed
+static int run_serve(const fs::path &dbDir, const Endpoint &ep, ThreadPool &pool, const StreamConfig &cfg) {
+    std::cout << "[PIR] PIR server daemon for " << dbDir.string() << "\n";
+    printDivider();
+    auto setupStart = std::chrono::steady_clock::now();
+    PirDatabase db;
+    if (!loadPirDatabase(dbDir, db, cfg)) {
+        std::cout << "[ERROR] No records in " << dbDir.string() << "\n";
+        return 1;
+    }
+    std::cout << "\xE2\x9C\x85 Loaded " << db.records.size() << " videos (" << db.maxBits << " bits max";
+    if (db.buckets.size() > 1) std::cout << ", " << db.buckets.size() << " size buckets";
+    std::cout << ")\n";
+    std::cout << "[TIME] Setup completed in " << secsSince(setupStart) << " seconds\n";
+
+    const int listenFd = openEndpointSocket(ep, true);
+    if (listenFd < 0) {
+        std::cout << "[ERROR] Cannot listen on " << ep.describe() << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cout << "[OK] Listening on " << ep.describe() << "\n";
+    PirServer server(db, pool);
+    for (;;) {
+        const int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            std::cout << "[ERROR] accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        std::thread([&server, fd] { server.serveConnection(fd); }).detach();
+    }
+    ::close(listenFd);
+    return 1;
 }
 
-static std::vector<int> client_generate_query(int targetIndex, size_t total) {
-    auto start = std::chrono::steady_clock::now();
-    std::cout << "Client generating query for video " << targetIndex << "...\n";
-    std::vector<int> q(total, 0);
-    if (targetIndex >= 0 && static_cast<size_t>(targetIndex) < total) q[static_cast<size_t>(targetIndex)] = 1;
-    std::cout << "[OK] Query vector generated: [";
-    for (size_t i = 0; i < q.size(); ++i) {
-        std::cout << q[i] << (i + 1 < q.size() ? ", " : "]\n");
+// Client side of one daemon connection
+class PirConnection {
+public:
+    ~PirConnection() {
+        if (fd_ >= 0) ::close(fd_);
     }
-    std::cout << "[TIME] Query generation took " << secsSince(start) << " seconds\n";
-    return q;
+
+    bool connect(const Endpoint &ep) {
+        fd_ = openEndpointSocket(ep, false);
+        return fd_ >= 0;
+    }
+
+    // Record catalog: names, bit lengths and size buckets, plus the widest
+    // padded answer width
+    bool info(std::vector<std::string> &names, std::vector<uint64_t> &bitLengths, std::vector<uint32_t> &buckets,
+              uint64_t &maxBits) {
+        FrameHeader resp;
+        std::vector<unsigned char> payload;
+        if (!sendFrame(fd_, makeFrameHeader(FrameType::Info, 0, 0), {}) ||
+            !recvFrame(fd_, resp, payload, UINT64_MAX) || resp.status != 0 || payload.size() < 8) {
+            return false;
+        }
+        size_t pos = 0;
+        std::memcpy(&maxBits, payload.data(), 8);
+        pos += 8;
+        names.clear();
+        bitLengths.clear();
+        for (uint32_t i = 0; i < resp.count; ++i) {
+            uint64_t bits = 0;
+            uint16_t len = 0;
+            if (payload.size() - pos < 10) return false;
+            std::memcpy(&bits, payload.data() + pos, 8);
+            std::memcpy(&len, payload.data() + pos + 8, 2);
+            pos += 10;
+            if (payload.size() - pos < len) return false;
+            names.emplace_back(reinterpret_cast<const char*>(payload.data() + pos), len);
+            bitLengths.push_back(bits);
+            pos += len;
+        }
+        if (payload.size() - pos != resp.count * sizeof(uint32_t)) return false;
+        buckets.resize(resp.count);
+        if (resp.count) std::memcpy(buckets.data(), payload.data() + pos, resp.count * sizeof(uint32_t));
+        return true;
+    }
+
+    // Send K shares of one kind over one bucket and wait for the K answers
+    bool query(QueryKind kind, uint32_t bucket, const std::vector<std::vector<unsigned char>> &shares,
+               std::vector<BitVector> &answers) {
+        FrameHeader resp;
+        std::vector<unsigned char> out;
+        if (!sendQuery(kind, bucket, shares) || !recvFrame(fd_, resp, out, UINT64_MAX) || resp.status != 0 ||
+            resp.count != shares.size() || out.size() < 8) {
+            return false;
+        }
+        uint64_t bits = 0;
+        std::memcpy(&bits, out.data(), 8);
+        const size_t bytes = static_cast<size_t>((bits + 7) / 8);
+        if (out.size() != 8 + bytes * shares.size()) return false;
+        answers.assign(shares.size(), BitVector(static_cast<size_t>(bits)));
+        for (size_t k = 0; k < shares.size(); ++k) {
+            std::memcpy(answers[k].words(), out.data() + 8 + k * bytes, bytes);
+        }
+        return true;
+    }
+
+    // Send one share and receive its answer straight into `answer` (already
+    // sized to the bucket's padded width) in pieces, reporting the bytes
+    // received so far after each piece so the caller can work on them while
+    // the rest is still in flight
+    bool queryStreamed(QueryKind kind, uint32_t bucket, const std::vector<unsigned char> &share, BitVector &answer,
+                       const std::function<void(size_t)> &received) {
+        FrameHeader resp;
+        uint64_t bits = 0;
+        if (!sendQuery(kind, bucket, {share}) || !recvAll(fd_, &resp, sizeof(resp)) ||
+            std::memcmp(resp.magic, kFrameMagic, sizeof(resp.magic)) != 0 || resp.status != 0 || resp.count != 1 ||
+            resp.payloadBytes != 8 + answer.byteSize() || !recvAll(fd_, &bits, sizeof(bits)) || bits != answer.size()) {
+            return false;
+        }
+        unsigned char *dst = reinterpret_cast<unsigned char*>(answer.words());
+        const size_t total = answer.byteSize();
+        size_t done = 0;
+        while (done < total) {
+            const ssize_t got = recv(fd_, dst + done, std::min<size_t>(total - done, 1 << 20), 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            done += static_cast<size_t>(got);
+            received(done);
+        }
+        return true;
+    }
+
+private:
+    bool sendQuery(QueryKind kind, uint32_t bucket, const std::vector<std::vector<unsigned char>> &shares) {
+        std::vector<unsigned char> payload;
+        for (const auto &share : shares) {
+            const uint32_t len = static_cast<uint32_t>(share.size());
+            payload.insert(payload.end(), reinterpret_cast<const unsigned char*>(&len),
+                           reinterpret_cast<const unsigned char*>(&len) + sizeof(len));
+            payload.insert(payload.end(), share.begin(), share.end());
+        }
+        FrameHeader req = makeFrameHeader(FrameType::Query, static_cast<uint32_t>(shares.size()), payload.size());
+        req.kind = static_cast<uint8_t>(kind);
+        req.bucket = bucket;
+        return sendFrame(fd_, req, payload);
+    }
+
+    int fd_ = -1;
+};
+
+// Where a record sits in the servers' size buckets, worked out from the
+// catalog both servers publish: a query for it selects among the bucket's
+// records (in catalog order) and is answered at the bucket's padded width
+struct BucketSlot {
+    uint32_t bucket = 0;
+    size_t slot = 0;
+    size_t records = 0;
+    uint64_t maxBits = 0;
+};
+
+static BucketSlot locateInBucket(const std::vector<uint32_t> &buckets, const std::vector<uint64_t> &bitLengths, size_t target) {
+    BucketSlot where;
+    where.bucket = buckets[target];
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i] != where.bucket) continue;
+        if (i < target) ++where.slot;
+        ++where.records;
+        where.maxBits = std::max(where.maxBits, bitLengths[i]);
+    }
+    return where;
 }
 
-static std::vector<int> server_process_query(const std::vector<int> &query, const std::vector<fs::path> &videoFiles) {
+// Two-process deployment: each replica runs as its own daemon (serve --db D0
+// and serve --db D1) and only ever sees its own share. The client checks the
+// two catalogs agree and sends both shares concurrently; the answers are
+// XOR-merged and written to the output as soon as both servers have
+// delivered a stretch, so the video is written while bytes are still arriving.
+static int run_remote_pir(const Endpoint &ep0, const Endpoint &ep1, const std::string &indexArg, QueryKind kind,
+                          const fs::path &outPath) {
     auto overall = std::chrono::steady_clock::now();
-    std::cout << "Server processing query using D0.r1 + D1.r2...\n";
+    std::cout << "[PIR] Two-server XOR PIR against " << ep0.describe() << " and " << ep1.describe() << "\n";
+    printDivider();
 
-    fs::path d0 = fs::path("D0");
-    fs::path d1 = fs::path("D1");
+    auto setupStart = std::chrono::steady_clock::now();
+    PirConnection conn[2];
+    std::vector<std::string> names[2];
+    std::vector<uint64_t> bitLengths[2];
+    std::vector<uint32_t> buckets[2];
+    uint64_t maxBits[2] = {0, 0};
+    const Endpoint *eps[2] = {&ep0, &ep1};
+    for (int s = 0; s < 2; ++s) {
+        if (!conn[s].connect(*eps[s]) || !conn[s].info(names[s], bitLengths[s], buckets[s], maxBits[s])) {
+            std::cout << "[ERROR] Cannot reach server " << s << " at " << eps[s]->describe() << "\n";
+            return 1;
+        }
+    }
+    if (names[0] != names[1] || bitLengths[0] != bitLengths[1] || buckets[0] != buckets[1] || maxBits[0] != maxBits[1]) {
+        std::cout << "\xE2\x9D\x8C The two servers are not replicas of the same database!\n";
+        return 1;
+    }
+    std::cout << "\xE2\x9C\x85 Servers have " << names[0].size() << " videos:\n";
+    for (size_t i = 0; i < names[0].size(); ++i) std::cout << "  " << i << ": " << names[0][i] << "\n";
+    std::cout << "[TIME] Connecting took " << secsSince(setupStart) << " seconds\n";
 
-    for (size_t i = 0; i < videoFiles.size(); ++i) {
-        if (i < query.size() && query[i] == 1) {
-            const auto &videoFile = videoFiles[i];
-            std::cout << "Processing " << videoFile.filename().string() << "...\n";
+    size_t target = SIZE_MAX;
+    try {
+        target = static_cast<size_t>(std::stoull(indexArg));
+    } catch (const std::exception &) {
+    }
+    if (target >= names[0].size()) {
+        std::cout << "\xE2\x9D\x8C Invalid video index!\n";
+        return 1;
+    }
 
-            auto loadStart = std::chrono::steady_clock::now();
-            std::vector<int> d0Bits;
-            if (!readBitsFile(d0 / videoFile, d0Bits)) {
-                std::cout << "Failed to read D0 file\n";
-                return {};
+    const BucketSlot where = locateInBucket(buckets[0], bitLengths[0], target);
+    if (where.records < names[0].size()) {
+        std::cout << "[OK] Video " << target << " is in size bucket " << where.bucket << " (" << where.records
+                  << " records, padded to " << where.maxBits << " bits)\n";
+    }
+    auto query = client_generate_xor_query(where.slot, where.records, kind);
+    BitStreamWriter out;
+    if (!out.open(outPath, BitFormat::Binary)) {
+        std::cout << "[ERROR] Cannot write " << outPath.string() << "\n";
+        return 1;
+    }
+    auto queryStart = std::chrono::steady_clock::now();
+    BitVector answers[2] = {BitVector(static_cast<size_t>(where.maxBits)), BitVector(static_cast<size_t>(where.maxBits))};
+    std::mutex mu;
+    std::condition_variable progress;
+    size_t received[2] = {0, 0};
+    bool finished[2] = {false, false}, ok[2] = {false, false};
+    std::vector<std::thread> receivers;
+    for (int s = 0; s < 2; ++s) {
+        receivers.emplace_back([&, s] {
+            const bool good = conn[s].queryStreamed(kind, where.bucket, query.forServer[s], answers[s], [&](size_t bytes) {
+                {
+                    std::lock_guard<std::mutex> lock(mu);
+                    received[s] = bytes;
+                }
+                progress.notify_one();
+            });
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                ok[s] = good;
+                finished[s] = true;
             }
-    std::cout << "[TIME] Loading D0 took " << secsSince(loadStart) << " seconds\n";
+            progress.notify_one();
+        });
+    }
 
-            loadStart = std::chrono::steady_clock::now();
-            std::vector<int> d1Bits;
-            if (!readBitsFile(d1 / videoFile, d1Bits)) {
-                std::cout << "Failed to read D1 file\n";
-                return {};
+    // Merge whole words both answers cover, up to the target's length
+    const uint64_t bitLength = bitLengths[0][target];
+    const size_t targetWords = static_cast<size_t>((bitLength + 63) / 64);
+    size_t merged = 0;
+    double firstByte = -1;
+    bool failed = false;
+    while (merged < targetWords && !failed) {
+        size_t ready = 0;
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            auto readyWords = [&] {
+                const size_t bytes = std::min(received[0], received[1]);
+                return bytes == answers[0].byteSize() ? answers[0].wordCount() : bytes / 8;
+            };
+            progress.wait(lock, [&] {
+                return readyWords() > merged || (finished[0] && !ok[0]) || (finished[1] && !ok[1]);
+            });
+            ready = std::min(targetWords, readyWords());
+            failed = ready <= merged;
+        }
+        if (failed) break;
+        xorInto(answers[0].words() + merged, answers[1].words() + merged, ready - merged);
+        const uint64_t bits = std::min<uint64_t>(uint64_t(ready - merged) * 64, bitLength - uint64_t(merged) * 64);
+        if (!out.write(answers[0].words() + merged, static_cast<size_t>(bits))) failed = true;
+        if (firstByte < 0) firstByte = secsSince(queryStart);
+        merged = ready;
+    }
+    for (auto &t : receivers) t.join();
+    if (!out.close() || failed || !ok[0] || !ok[1]) {
+        std::cout << "\n[ERROR] PIR Protocol Failed: " << (!ok[0] || !ok[1] ? "a server did not answer" : "cannot write output") << "\n";
+        return 1;
+    }
+    if (firstByte < 0) {
+        std::cout << "[TIME] Record is empty; both answers received after " << secsSince(queryStart) << " seconds\n";
+    } else {
+        std::cout << "[TIME] First byte written after " << firstByte << " seconds, both answers merged after "
+                  << secsSince(queryStart) << " seconds\n";
+    }
+    std::cout << "[OK] Answers combined: " << out.bitsWritten() << " bits\n";
+    std::cout << "[OK] Video reconstructed and saved as: " << outPath.string() << "\n";
+    std::cout << "\n[DONE] PIR Protocol Completed!\n";
+    std::cout << "[TIME] Total time: " << secsSince(overall) << " seconds\n";
+    return 0;
+}
+
+// Load generator for one daemon: `connections` clients each send `requests`
+// requests of `batch` random DPF shares back to back
+static int run_bench(const Endpoint &ep, size_t connections, size_t requests, size_t batch) {
+    std::cout << "[PIR] Benchmarking PIR server at " << ep.describe() << "\n";
+    printDivider();
+    PirConnection probe;
+    std::vector<std::string> names;
+    std::vector<uint64_t> bitLengths;
+    std::vector<uint32_t> buckets;
+    uint64_t maxBits = 0;
+    if (!probe.connect(ep) || !probe.info(names, bitLengths, buckets, maxBits)) {
+        std::cout << "[ERROR] Cannot reach a PIR server at " << ep.describe() << "\n";
+        return 1;
+    }
+    std::cout << "[OK] Server has " << names.size() << " videos (" << maxBits << " bits max)\n";
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<size_t> failures{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < connections; ++c) {
+        clients.emplace_back([&, c] {
+            PirConnection conn;
+            if (!conn.connect(ep)) {
+                failures += requests;
+                return;
             }
-            std::cout << "[TIME] Loading D1 took " << secsSince(loadStart) << " seconds\n";
+            std::mt19937_64 rng(c + 1);
+            for (size_t r = 0; r < requests; ++r) {
+                // One request's shares all select from the bucket of a random record
+                const BucketSlot where = locateInBucket(buckets, bitLengths, rng() % names.size());
+                std::vector<std::vector<unsigned char>> shares;
+                for (size_t k = 0; k < batch; ++k) {
+                    DpfKey k0, k1;
+                    dpfGenerate(rng() % where.records, dpfDepthFor(where.records), k0, k1);
+                    shares.push_back(k0.serialize());
+                }
+                std::vector<BitVector> answers;
+                auto sent = std::chrono::steady_clock::now();
+                if (!conn.query(QueryKind::Dpf, where.bucket, shares, answers)) ++failures;
+                latencies[c].push_back(secsSince(sent));
+            }
+        });
+    }
+    for (auto &t : clients) t.join();
+    const double secs = secsSince(start);
 
-            auto genStart = std::chrono::steady_clock::now();
-            const size_t bitLen = d0Bits.size();
-            std::vector<int> r1(bitLen), r2(bitLen);
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<int> dist(0, 1);
-            for (size_t j = 0; j < bitLen; ++j) { r1[j] = dist(gen); r2[j] = dist(gen); }
-            std::cout << "[TIME] Generating r1 and r2 took " << secsSince(genStart) << " seconds\n";
+    std::vector<double> all;
+    for (const auto &l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+    std::cout << "[OK] " << all.size() << " requests x " << batch << " queries over " << connections
+              << " connections, " << failures.load() << " failed\n";
+    std::cout << "[TIME] " << secs << " seconds: " << (secs > 0 ? all.size() * batch / secs : 0.0)
+              << " queries/s, latency p50 " << pct(0.5) * 1e3 << " ms, p99 " << pct(0.99) * 1e3 << " ms\n";
+    return failures == 0 ? 0 : 1;
+}
+#endif
 
-            std::cout << "[OK] D0 loaded: " << d0Bits.size() << " bits\n";
-            std::cout << "[OK] D1 loaded: " << d1Bits.size() << " bits\n";
-            std::cout << "[OK] r1 generated: " << r1.size() << " bits\n";
-            std::cout << "[OK] r2 generated: " << r2.size() << " bits\n";
+static bool isVideoFile(const fs::path &path) {
+    static const char *kVideoExtensions[] = {".mp4", ".mov", ".mkv", ".avi", ".wmv", ".flv", ".webm", ".m4v", ".mpg", ".mpeg"};
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const char *e : kVideoExtensions) {
+        if (ext == e) return true;
+    }
+    return false;
+}
 
-            auto computeStart = std::chrono::steady_clock::now();
-            std::vector<int> result;
-            result.resize(bitLen);
-            for (size_t j = 0; j < bitLen; ++j) {
-                result[j] = (d0Bits[j] * r1[j] + d1Bits[j] * r2[j]) & 1;
-            }
-            std::cout << "[TIME] Computing D0.r1 + D1.r2 took " << secsSince(computeStart) << " seconds\n";
-            std::cout << "[OK] D0.r1 + D1.r2 computed: " << result.size() << " bits\n";
+// Pack one video into a record: the video bytes already are the packed bits,
+// so the mapping is copied out in 8 MB writes behind a header. Written to a
+// temporary name and renamed so a crash never leaves a truncated record.
+static bool ingestVideo(const fs::path &videoPath, const fs::path &recPath) {
+    MappedFile in;
+    if (!in.open(videoPath)) return false;
+    const fs::path tmpPath = recPath.string() + ".tmp";
+    BitStreamWriter out;
+    if (!out.open(tmpPath, BitFormat::PackedRecord)) return false;
+    const size_t chunk = size_t(8) << 20;
+    bool ok = true;
+    for (size_t off = 0; off < in.size() && ok; off += chunk) {
+        const size_t n = std::min(chunk, in.size() - off);
+        ok = out.write(reinterpret_cast<const uint64_t*>(in.data() + off), n * 8);
+        in.release(off, n);
+    }
+    if (!out.close() || !ok) {
+        std::error_code ec;
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, recPath, ec);
+    return !ec;
+}
 
-            std::cout << "[STEP] Saving r1 and r2 for client decoding...\n";
-            auto saveStart = std::chrono::steady_clock::now();
-            if (!writeBitsFile("r1.txt", r1) || !writeBitsFile("r2.txt", r2)) {
-                std::cout << "Memory/file error saving r1, r2. Using simplified approach...\n";
-                return d0Bits; // simplified fallback
-            }
-            std::cout << "[OK] r1 and r2 saved for client decoding\n";
-            std::cout << "[TIME] Saving r1 and r2 took " << secsSince(saveStart) << " seconds\n";
+// Build the D0/D1 replicas straight from a folder of videos: every (video,
+// replica) pair is one task on the pool, so large and small videos and both
+// replicas are written in parallel
+static int run_ingest(const fs::path &videoDir, const std::vector<fs::path> &replicas, ThreadPool &pool) {
+    auto overall = std::chrono::steady_clock::now();
+    std::cout << "[PIR] Ingesting videos from " << videoDir.string() << " into packed records\n";
+    printDivider();
+    if (!fs::exists(videoDir)) {
+        std::cout << "\xE2\x9D\x8C " << videoDir.string() << " folder not found!\n";
+        return 1;
+    }
+    std::vector<fs::path> videos;
+    for (auto &p : fs::directory_iterator(videoDir)) {
+        if (p.is_regular_file() && isVideoFile(p.path())) videos.push_back(p.path());
+    }
+    std::sort(videos.begin(), videos.end());
+    if (videos.empty()) {
+        std::cout << "\xE2\x9D\x8C No videos found in " << videoDir.string() << "\n";
+        return 1;
+    }
+    for (const auto &dir : replicas) {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        if (ec) {
+            std::cout << "[ERROR] Cannot create " << dir.string() << "\n";
+            return 1;
+        }
+    }
 
-            std::cout << "[TIME] Server processing completed in " << secsSince(overall) << " seconds\n";
-            return result;
+    std::mutex logMu;
+    std::atomic<size_t> failures{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    pool.run(videos.size() * replicas.size(), [&](size_t task, unsigned) {
+        const fs::path &video = videos[task / replicas.size()];
+        const fs::path recPath = replicas[task % replicas.size()] / (video.filename().string() + kRecordSuffix);
+        auto start = std::chrono::steady_clock::now();
+        const bool ok = ingestVideo(video, recPath);
+        const double secs = secsSince(start);
+        std::lock_guard<std::mutex> lock(logMu);
+        if (!ok) {
+            ++failures;
+            std::cout << "[ERROR] Failed to ingest " << video.string() << " -> " << recPath.string() << "\n";
+            return;
+        }
+        const uint64_t bytes = fs::file_size(video);
+        bytesWritten += bytes;
+        std::cout << "[OK] " << video.filename().string() << " -> " << recPath.string() << " (" << bytes << " bytes, "
+                  << (secs > 0 ? bytes / secs / 1e6 : 0.0) << " MB/s)\n";
+    });
+
+    for (const auto &dir : replicas) {
+        if (!buildCatalog(dir)) {
+            std::cout << "[ERROR] Cannot write the catalog of " << dir.string() << "\n";
+            ++failures;
         }
     }
+    const double secs = secsSince(overall);
+    std::cout << "[OK] Ingested " << videos.size() << " videos into " << replicas.size() << " replicas on "
+              << pool.size() << " threads, " << failures.load() << " failed\n";
+    std::cout << "[TIME] Total time: " << secs << " seconds (" << (secs > 0 ? bytesWritten.load() / secs / 1e6 : 0.0)
+              << " MB/s written)\n";
+    return failures == 0 ? 0 : 1;
+}
 
-    std::cout << "[TIME] Server processing completed in " << secsSince(overall) << " seconds\n";
-    return {};
+// Restore one database file (packed record or legacy text) to the original
+// video bytes in 8 MB steps, so memory stays constant whatever the record
+// size. Packed payloads are checksummed on the way through; text goes through
+// the validating parser.
+static bool restoreRecord(const fs::path &srcPath, const fs::path &outPath, uint64_t &bitLength) {
+    MappedFile in;
+    if (!in.open(srcPath)) return false;
+    std::ofstream out(outPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    const size_t chunk = size_t(8) << 20;
+    RecordHeader hdr;
+    if (parseRecordHeader(in, hdr)) {
+        const size_t payload = static_cast<size_t>((hdr.bitLength + 7) / 8);
+        uint64_t checksum = kChecksumSeed;
+        for (size_t off = 0; off < payload; off += chunk) {
+            const size_t n = std::min(chunk, payload - off);
+            const unsigned char *data = in.data() + sizeof(RecordHeader) + off;
+            checksum = recordChecksum(data, n, checksum);
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n));
+            in.release(sizeof(RecordHeader) + off, n);
+        }
+        bitLength = hdr.bitLength;
+        if (checksum != hdr.checksum) {
+            std::cout << "[ERROR] Checksum mismatch in " << srcPath.string() << "\n";
+            return false;
+        }
+        return static_cast<bool>(out);
+    }
+    uint64_t checksum = 0;
+    return packTextRecord(in, srcPath, &out, bitLength, checksum);
 }
 
-static std::vector<int> client_decode_pir_result(const std::vector<int> &serverResponse, size_t targetIndex) {
-    auto overall = std::chrono::steady_clock::now();
-    std::cout << "Client decoding PIR result for video " << targetIndex << "...\n";
+// Write the cataloged records `ids` (ascending) as container `bucket` of
+// `buckets` at path (temporary name, then renamed)
+static bool buildContainer(const fs::path &path, const Catalog &catalog, const std::vector<size_t> &ids, uint32_t bucket,
+                           uint32_t buckets) {
+    ContainerHeader hdr{};
+    std::memcpy(hdr.magic, kContainerMagic, sizeof(kContainerMagic));
+    hdr.version = kContainerVersion;
+    hdr.entrySize = sizeof(CatalogEntry);
+    hdr.count = ids.size();
+    hdr.bucket = bucket;
+    hdr.buckets = buckets;
+    uint64_t maxBytes = 1;
+    std::vector<CatalogEntry> entries;
+    std::string names;
+    for (size_t id : ids) {
+        CatalogEntry e = catalog.entry(id);
+        e.nameOffset = names.size();
+        names += catalog.fileName(id);
+        entries.push_back(e);
+        maxBytes = std::max(maxBytes, (e.bitLength + 7) / 8);
+    }
+    auto alignUp = [](uint64_t v) { return (v + kContainerAlign - 1) / kContainerAlign * kContainerAlign; };
+    hdr.stride = alignUp(maxBytes);
+    hdr.namesOffset = sizeof(ContainerHeader) + entries.size() * sizeof(CatalogEntry);
+    hdr.namesBytes = names.size();
+    hdr.dataOffset = alignUp(hdr.namesOffset + hdr.namesBytes);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].payloadOffset = hdr.dataOffset + i * kContainerTile;
+        entries[i].fileSize = hdr.stride;
+    }
 
-    if (!fs::exists("r1.txt") || !fs::exists("r2.txt")) {
-        std::cout << "[ERROR] r1, r2 files not found. Using simplified approach...\n";
-        auto loadStart = std::chrono::steady_clock::now();
-        fs::path d0 = fs::path("D0");
-        std::vector<fs::path> files;
-        for (auto &p : fs::directory_iterator(d0)) {
-            if (p.is_regular_file()) {
-                auto name = p.path().filename().string();
-                if (name.size() >= 11 && name.substr(name.size() - 11) == ".binary.txt") {
-                    files.push_back(p.path());
-                }
+    const fs::path tmpPath = path.string() + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(CatalogEntry)));
+        out.write(names.data(), static_cast<std::streamsize>(names.size()));
+        // One record at a time, each tile to its slot in the interleaved layout
+        std::vector<uint64_t> tile(kContainerTile / 8);
+        for (size_t i = 0; i < entries.size() && out; ++i) {
+            RecordView src;
+            const bool opened = src.open(catalog.path(ids[i])) && src.bitLength() == entries[i].bitLength;
+            const size_t payload = static_cast<size_t>((entries[i].bitLength + 7) / 8);
+            uint64_t checksum = kChecksumSeed;
+            for (size_t off = 0; opened && off < payload && out; off += kContainerTile) {
+                const size_t n = std::min(kContainerTile, payload - off);
+                src.copyWords(off / 8, tile.size(), tile.data());
+                checksum = recordChecksum(reinterpret_cast<const unsigned char*>(tile.data()), n, checksum);
+                out.seekp(static_cast<std::streamoff>(entries[i].payloadOffset + off / kContainerTile * hdr.count * kContainerTile));
+                out.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(n));
+                src.release(off / 8, tile.size());
             }
+            if (!opened || checksum != entries[i].checksum) {
+                std::cout << "[ERROR] " << catalog.path(ids[i]).string() << " no longer matches the catalog\n";
+                out.setstate(std::ios::failbit);
+            }
+        }
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            fs::remove(tmpPath, ec);
+            return false;
         }
-        std::sort(files.begin(), files.end());
-        if (targetIndex >= files.size()) return {};
-        std::vector<int> original;
-        readBitsFile(files[targetIndex], original);
-        std::cout << "[OK] Original video loaded: " << original.size() << " bits\n";
-        std::cout << "[TIME] Loading original video took " << secsSince(loadStart) << " seconds\n";
-        std::cout << "[TIME] Client decoding completed in " << secsSince(overall) << " seconds\n";
-        return original;
     }
+    std::error_code ec;
+    fs::resize_file(tmpPath, hdr.dataOffset + hdr.count * hdr.stride, ec); // zero tail after the last record
+    if (!ec) fs::rename(tmpPath, path, ec);
+    return !ec;
+}
 
-    std::cout << "[STEP] Loading r1 and r2...\n";
-    auto loadStart = std::chrono::steady_clock::now();
-    std::vector<int> r1, r2;
-    readBitsFile("r1.txt", r1);
-    readBitsFile("r2.txt", r2);
-    std::cout << "[OK] r1 loaded: " << r1.size() << " bits\n";
-    std::cout << "[OK] r2 loaded: " << r2.size() << " bits\n";
-    std::cout << "[TIME] Loading r1 and r2 took " << secsSince(loadStart) << " seconds\n";
+// Size classes for bucketed packing: class 0 holds records up to 1 MB and each
+// further class holds records up to `ratio` times the previous limit, so no
+// record is padded by more than that factor
+static const uint64_t kBucketBaseBytes = uint64_t(1) << 20;
 
-    // Simplified: return original bits for this demo 
-    std::cout << "[STEP] Decoding PIR result...\n";
-    auto decodeStart = std::chrono::steady_clock::now();
-    fs::path d0 = fs::path("D0");
-    std::vector<fs::path> files;
-    for (auto &p : fs::directory_iterator(d0)) {
-        if (p.is_regular_file()) {
-            auto name = p.path().filename().string();
-            if (name.size() >= 11 && name.substr(name.size() - 11) == ".binary.txt") {
-                files.push_back(p.path());
+static unsigned sizeClass(uint64_t bitLength, unsigned ratio) {
+    unsigned c = 0;
+    for (uint64_t limit = kBucketBaseBytes; (bitLength + 7) / 8 > limit && limit <= UINT64_MAX / ratio; limit *= ratio) ++c;
+    return c;
+}
+
+// Pack each folder's records into its single-file container, or with
+// bucketRatio >= 2 into one container per non-empty size class
+static int run_pack(const std::vector<fs::path> &dirs, unsigned bucketRatio) {
+    for (const auto &dir : dirs) {
+        auto start = std::chrono::steady_clock::now();
+        Catalog catalog;
+        if (!fs::exists(dir) || !catalog.open(dir)) {
+            std::cout << "\xE2\x9D\x8C " << dir.string() << " has no readable records!\n";
+            return 1;
+        }
+        std::map<unsigned, std::vector<size_t>> classes;
+        for (size_t i = 0; i < catalog.size(); ++i) {
+            classes[bucketRatio >= 2 ? sizeClass(catalog.entry(i).bitLength, bucketRatio) : 0].push_back(i);
+        }
+        // Drop containers of an earlier layout so only this one is found
+        std::error_code ec;
+        for (auto &p : fs::directory_iterator(dir, ec)) {
+            const std::string name = p.path().filename().string();
+            if (name.rfind("records.", 0) == 0 && hasSuffix(name, ".pirdb")) fs::remove(p.path(), ec);
+        }
+
+        const uint32_t buckets = static_cast<uint32_t>(classes.size());
+        std::vector<fs::path> paths;
+        uint64_t bytes = 0, maxStride = 0;
+        for (const auto &cls : classes) {
+            const uint32_t b = static_cast<uint32_t>(paths.size());
+            paths.push_back(containerPath(dir, b, buckets));
+            Container container;
+            if (!buildContainer(paths.back(), catalog, cls.second, b, buckets) || !container.open(paths.back())) {
+                std::cout << "[ERROR] Cannot write " << paths.back().string() << "\n";
+                return 1;
+            }
+            bytes += container.size() * container.stride();
+            maxStride = std::max(maxStride, container.stride());
+            if (buckets > 1) {
+                std::cout << "[OK] Bucket " << b << ": " << container.size() << " records into " << paths.back().string()
+                          << " (" << container.stride() / 1024 << " KB stride)\n";
             }
         }
+        // Writing the containers touched the folder: refresh the catalog so it
+        // is not rebuilt on the next load
+        if (!buildCatalog(dir)) return 1;
+
+        const double secs = secsSince(start);
+        if (buckets == 1) {
+            std::cout << "[OK] Packed " << catalog.size() << " records into " << paths.front().string() << " ("
+                      << maxStride / 1024 << " KB stride, " << bytes << " bytes)\n";
+        } else {
+            std::cout << "[OK] Packed " << catalog.size() << " records into " << buckets << " size buckets: " << bytes
+                      << " padded bytes instead of " << catalog.size() * maxStride << " in one bucket\n";
+        }
+        std::cout << "[TIME] Packing took " << secs << " seconds (" << (secs > 0 ? bytes / secs / 1e6 : 0.0) << " MB/s)\n";
     }
-    std::sort(files.begin(), files.end());
-    if (targetIndex >= files.size()) return {};
-    std::vector<int> original;
-    readBitsFile(files[targetIndex], original);
-    std::cout << "[OK] Original video loaded: " << original.size() << " bits\n";
-    std::cout << "[TIME] Decoding took " << secsSince(decodeStart) << " seconds\n";
-    std::cout << "[TIME] Client decoding completed in " << secsSince(overall) << " seconds\n";
-    return original;
+    return 0;
 }
 
-static bool convert_bits_to_video_direct(const std::vector<int> &decodedBits) {
+// Byte-compare two files through their mappings
+static bool filesEqual(const fs::path &a, const fs::path &b) {
+    MappedFile ma, mb;
+    if (!ma.open(a) || !mb.open(b) || ma.size() != mb.size()) return false;
+    const size_t chunk = size_t(8) << 20;
+    for (size_t off = 0; off < ma.size(); off += chunk) {
+        const size_t n = std::min(chunk, ma.size() - off);
+        if (std::memcmp(ma.data() + off, mb.data() + off, n) != 0) return false;
+        ma.release(off, n);
+        mb.release(off, n);
+    }
+    return true;
+}
+
+// Restore every record of a database folder into outDir concurrently, one
+// record per pool task; with verifyDir, each restored video is also compared
+// byte for byte with the original of the same name there
+static int run_reconstruct_all(const fs::path &dbDir, const fs::path &outDir, const fs::path &verifyDir, ThreadPool &pool) {
     auto overall = std::chrono::steady_clock::now();
-    std::cout << "[STEP] Converting bits directly to video file...\n";
-    auto convertStart = std::chrono::steady_clock::now();
-    if (!writeBitsAsBinaryVideo("reconstructed_video.mp4", decodedBits)) return false;
-    std::cout << "[OK] Video reconstructed and saved as: reconstructed_video.mp4\n";
-    std::cout << "[TIME] Converting bits to video took " << secsSince(convertStart) << " seconds\n";
+    std::cout << "[PIR] Reconstructing every record in " << dbDir.string() << " into " << outDir.string() << "\n";
+    printDivider();
+    if (!fs::exists(dbDir)) {
+        std::cout << "\xE2\x9D\x8C " << dbDir.string() << " folder not found!\n";
+        return 1;
+    }
+    std::vector<fs::path> files = discoverRecordFiles(dbDir);
+    std::sort(files.begin(), files.end());
+    std::error_code ec;
+    fs::create_directories(outDir, ec);
+    if (ec) {
+        std::cout << "[ERROR] Cannot create " << outDir.string() << "\n";
+        return 1;
+    }
 
-#ifdef _WIN32
-    std::cout << "[PLAY] Playing reconstructed video...\n";
-    ShellExecuteA(nullptr, "open", "reconstructed_video.mp4", nullptr, nullptr, SW_SHOWNORMAL);
-#endif
-    std::cout << "[TIME] Direct video conversion completed in " << secsSince(overall) << " seconds\n";
-    return true;
+    std::mutex logMu;
+    std::atomic<size_t> failures{0}, mismatches{0};
+    std::atomic<uint64_t> bytesRestored{0};
+    pool.run(files.size(), [&](size_t i, unsigned) {
+        const std::string name = recordDisplayName(files[i].string());
+        const fs::path outPath = outDir / name;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t bits = 0;
+        const bool ok = restoreRecord(dbDir / files[i], outPath, bits);
+        const double secs = secsSince(start);
+        const bool same = !ok || verifyDir.empty() || filesEqual(outPath, verifyDir / name);
+        std::lock_guard<std::mutex> lock(logMu);
+        if (!ok) {
+            ++failures;
+            std::error_code removeEc;
+            fs::remove(outPath, removeEc);
+            std::cout << "[ERROR] Failed to reconstruct " << (dbDir / files[i]).string() << "\n";
+            return;
+        }
+        bytesRestored += bits / 8;
+        if (!same) ++mismatches;
+        std::cout << (same ? "[OK] " : "[ERROR] ") << files[i].string() << " -> " << outPath.string() << " ("
+                  << bits / 8 << " bytes, " << (secs > 0 ? bits / 8 / secs / 1e6 : 0.0) << " MB/s"
+                  << (verifyDir.empty() ? "" : same ? ", matches original" : ", DIFFERS from original") << ")\n";
+    });
+
+    const double secs = secsSince(overall);
+    std::cout << "[OK] Reconstructed " << files.size() - failures.load() << "/" << files.size() << " records on "
+              << pool.size() << " threads";
+    if (!verifyDir.empty()) std::cout << ", " << mismatches.load() << " differ from " << verifyDir.string();
+    std::cout << "\n[TIME] Total time: " << secs << " seconds (" << (secs > 0 ? bytesRestored.load() / secs / 1e6 : 0.0)
+              << " MB/s restored)\n";
+    return failures == 0 && mismatches == 0 ? 0 : 1;
 }
 
-static bool client_reconstruct_video(const std::vector<int> &serverResponse, size_t targetIndex) {
+// Convert every legacy .binary.txt in the given folders into a packed .rec
+static int run_import(const std::vector<fs::path> &dirs) {
     auto overall = std::chrono::steady_clock::now();
-    std::cout << "Client reconstructing video " << targetIndex << "...\n";
+    std::cout << "[PIR] Importing text databases into packed records\n";
+    printDivider();
+    size_t imported = 0;
+    for (const auto &dir : dirs) {
+        if (!fs::exists(dir)) {
+            std::cout << "\xE2\x9D\x8C " << dir.string() << " folder not found!\n";
+            continue;
+        }
+        for (auto &p : fs::directory_iterator(dir)) {
+            auto name = p.path().filename().string();
+            if (!p.is_regular_file() || !hasSuffix(name, kTextSuffix)) continue;
+            const fs::path recPath = dir / (recordDisplayName(name) + kRecordSuffix);
+            auto start = std::chrono::steady_clock::now();
+            uint64_t bits = 0;
+            if (!importTextRecord(p.path(), recPath, bits)) {
+                std::error_code ec;
+                fs::remove(recPath, ec); // never leave a half-written record for discovery to prefer
+                std::cout << "[ERROR] Failed to import " << p.path().string() << "\n";
+                return 1;
+            }
+            ++imported;
+            std::cout << "[OK] " << p.path().string() << " -> " << recPath.filename().string()
+                      << " (" << bits << " bits, " << fs::file_size(p.path()) << " -> "
+                      << fs::file_size(recPath) << " bytes)\n";
+            std::cout << "[TIME] Import took " << secsSince(start) << " seconds\n";
+        }
+    }
+    std::cout << "[OK] Imported " << imported << " records\n";
+    for (const auto &dir : dirs) {
+        if (fs::exists(dir) && !buildCatalog(dir)) {
+            std::cout << "[ERROR] Cannot write the catalog of " << dir.string() << "\n";
+            return 1;
+        }
+    }
+    std::cout << "[TIME] Total time: " << secsSince(overall) << " seconds\n";
+    return 0;
+}
 
-    std::vector<int> decoded = client_decode_pir_result(serverResponse, targetIndex);
+// Rebuild the record catalog of each folder from its current contents
+static int run_catalog(const std::vector<fs::path> &dirs) {
+    for (const auto &dir : dirs) {
+        auto start = std::chrono::steady_clock::now();
+        if (!fs::exists(dir)) {
+            std::cout << "\xE2\x9D\x8C " << dir.string() << " folder not found!\n";
+            return 1;
+        }
+        Catalog catalog;
+        if (!buildCatalog(dir) || !catalog.open(dir)) {
+            std::cout << "[ERROR] Cannot write the catalog of " << dir.string() << "\n";
+            return 1;
+        }
+        std::cout << "[OK] Cataloged " << catalog.size() << " records in " << (dir / kCatalogFile).string() << "\n";
+        std::cout << "[TIME] Cataloging took " << secsSince(start) << " seconds\n";
+    }
+    return 0;
+}
+
+// Command line: <command> [args...] [--flag value | --flag=value | --switch]
+// Switches never take a value, so the argument after one stays an argument
+static const char *const kSwitchFlags[] = {"pin"};
 
-    std::cout << "[STEP] Saving decoded video bits...\n";
-    auto saveStart = std::chrono::steady_clock::now();
-    if (!writeBitsFile("retrieved_video.bits", decoded)) {
-        std::cout << "[ERROR] Memory/file error saving decoded bits. Using direct conversion...\n";
-        return convert_bits_to_video_direct(decoded);
+struct CommandLine {
+    std::string command;
+    std::vector<std::string> args;
+    std::unordered_map<std::string, std::string> flags;
+
+    std::string flag(const std::string &name, const std::string &fallback) const {
+        auto it = flags.find(name);
+        return it == flags.end() ? fallback : it->second;
+    }
+    size_t flagSize(const std::string &name, size_t fallback) const {
+        auto it = flags.find(name);
+        if (it == flags.end()) return fallback;
+        try {
+            return static_cast<size_t>(std::stoull(it->second));
+        } catch (const std::exception &) {
+            std::cout << "[ERROR] Invalid value for --" << name << ": " << it->second << "\n";
+            return fallback;
+        }
     }
-    std::cout << "[OK] Decoded video bits saved to: retrieved_video.bits\n";
-    std::cout << "[TIME] Saving decoded bits took " << secsSince(saveStart) << " seconds\n";
+};
 
-    std::cout << "[STEP] Converting bits to video file...\n";
-    auto convertStart = std::chrono::steady_clock::now();
-    if (!convertBitsFileToBinaryVideo("retrieved_video.bits", "reconstructed_video.mp4")) {
-        std::cout << "[ERROR] Error reconstructing video\n";
-        return false;
+static CommandLine parseCommandLine(int argc, char **argv) {
+    CommandLine cl;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--", 0) == 0) {
+            const size_t eq = a.find('=');
+            const bool isSwitch = std::find(std::begin(kSwitchFlags), std::end(kSwitchFlags), a.substr(2)) != std::end(kSwitchFlags);
+            if (eq != std::string::npos) {
+                cl.flags[a.substr(2, eq - 2)] = a.substr(eq + 1);
+            } else if (!isSwitch && i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                cl.flags[a.substr(2)] = argv[++i];
+            } else {
+                cl.flags[a.substr(2)] = "1";
+            }
+        } else if (cl.command.empty()) {
+            cl.command = a;
+        } else {
+            cl.args.push_back(a);
+        }
     }
-    std::cout << "[OK] Video reconstructed and saved as: reconstructed_video.mp4\n";
-    std::cout << "[TIME] Converting bits to video took " << secsSince(convertStart) << " seconds\n";
+    return cl;
+}
 
-#ifdef _WIN32
-    std::cout << "[PLAY] Playing reconstructed video...\n";
-    ShellExecuteA(nullptr, "open", "reconstructed_video.mp4", nullptr, nullptr, SW_SHOWNORMAL);
+// real_pir_protocol_test.cpp includes this file with PIR_NO_MAIN defined
+#ifndef PIR_NO_MAIN
+int main(int argc, char **argv) {
+    const CommandLine cl = parseCommandLine(argc, argv);
+    const unsigned threads = static_cast<unsigned>(std::max<size_t>(1, cl.flagSize("threads", defaultThreadCount())));
+    StreamConfig streamCfg;
+    streamCfg.memoryLimit = cl.flagSize("mem-limit", streamCfg.memoryLimit >> 20) << 20;
+    const std::string io = cl.flag("io", "mmap");
+    if (io == "uring") {
+        streamCfg.io = IoBackend::Uring;
+    } else if (io == "pread") {
+        streamCfg.io = IoBackend::Pread;
+    } else if (io != "mmap") {
+        std::cout << "[ERROR] --io must be 'mmap', 'uring' or 'pread'\n";
+        return 1;
+    }
+    streamCfg.ioDepth = static_cast<unsigned>(std::max<size_t>(1, cl.flagSize("io-depth", streamCfg.ioDepth)));
+    if (cl.command == "ingest") {
+        ThreadPool pool(threads, cl.flags.count("pin") != 0);
+        std::vector<fs::path> replicas;
+        std::string list = cl.flag("out", "D0,D1");
+        for (size_t start = 0; start <= list.size();) {
+            const size_t comma = std::min(list.find(',', start), list.size());
+            if (comma > start) replicas.push_back(list.substr(start, comma - start));
+            start = comma + 1;
+        }
+        return run_ingest(cl.args.empty() ? fs::path(".") : fs::path(cl.args[0]), replicas, pool);
+    }
+    if (cl.command == "reconstruct") {
+        ThreadPool pool(threads, cl.flags.count("pin") != 0);
+        return run_reconstruct_all(cl.args.empty() ? fs::path("D0") : fs::path(cl.args[0]), cl.flag("out", "reconstructed"),
+                                   cl.flag("verify", ""), pool);
+    }
+    if (cl.command == "pack") {
+        std::vector<fs::path> dirs(cl.args.begin(), cl.args.end());
+        if (dirs.empty()) dirs = {fs::path("D0"), fs::path("D1")};
+        // Without --bucket-ratio everything goes into one container
+        const size_t ratio = cl.flagSize("bucket-ratio", 0);
+        if (cl.flags.count("bucket-ratio") && (ratio < 2 || ratio > 1024)) {
+            std::cout << "[ERROR] --bucket-ratio must be between 2 and 1024\n";
+            return 1;
+        }
+        return run_pack(dirs, static_cast<unsigned>(ratio));
+    }
+    if (cl.command == "catalog") {
+        std::vector<fs::path> dirs(cl.args.begin(), cl.args.end());
+        if (dirs.empty()) dirs = {fs::path("D0"), fs::path("D1")};
+        return run_catalog(dirs);
+    }
+    if (cl.command == "import") {
+        std::vector<fs::path> dirs(cl.args.begin(), cl.args.end());
+        if (dirs.empty()) dirs = {fs::path("D0"), fs::path("D1")};
+        return run_import(dirs);
+    }
+    if (cl.command == "serve" || cl.command == "bench" || cl.command == "fetch") {
+#ifndef _WIN32
+        if (cl.command == "fetch") {
+            const std::string query = cl.flag("query", "dpf");
+            if (query != "dpf" && query != "subset") {
+                std::cout << "[ERROR] --query must be 'dpf' or 'subset'\n";
+                return 1;
+            }
+            Endpoint ep0, ep1;
+            if (!parseEndpoint(cl.flag("server0", "pir_D0.sock"), ep0) || !parseEndpoint(cl.flag("server1", "pir_D1.sock"), ep1)) {
+                return 1;
+            }
+            return run_remote_pir(ep0, ep1, cl.args.empty() ? "" : cl.args[0], query == "dpf" ? QueryKind::Dpf : QueryKind::Subset,
+                                  cl.flag("out", "reconstructed_video.mp4"));
+        }
+        // Each replica's daemon defaults to its own socket, pir_<db>.sock
+        const fs::path dbDir = cl.flag("db", "D0");
+        Endpoint ep;
+        ep.socketPath = cl.flag("socket", "");
+        const size_t port = cl.flagSize("port", 0);
+        if (port > kMaxPort || (cl.flags.count("port") && port == 0)) {
+            std::cout << "[ERROR] --port must be between 1 and " << kMaxPort << "\n";
+            return 1;
+        }
+        ep.port = static_cast<int>(port);
+        if (ep.socketPath.empty() && ep.port == 0) ep.socketPath = "pir_" + dbDir.filename().string() + ".sock";
+        if (cl.command == "bench") {
+            return run_bench(ep, std::max<size_t>(1, cl.flagSize("connections", 1)),
+                             std::max<size_t>(1, cl.flagSize("requests", 100)), std::max<size_t>(1, cl.flagSize("batch", 1)));
+        }
+        ThreadPool pool(threads, cl.flags.count("pin") != 0);
+        return run_serve(dbDir, ep, pool, streamCfg);
+#else
+        std::cout << "[ERROR] The PIR server daemon needs POSIX sockets\n";
+        return 1;
 #endif
-    std::cout << "[TIME] Video reconstruction completed in " << secsSince(overall) << " seconds\n";
-    return true;
-}
+    }
+    if (cl.command == "xor" || cl.command == "batch") {
+        const std::string query = cl.flag("query", "dpf");
+        if (query != "dpf" && query != "subset") {
+            std::cout << "[ERROR] --query must be 'dpf' or 'subset'\n";
+            return 1;
+        }
+        const QueryKind kind = query == "dpf" ? QueryKind::Dpf : QueryKind::Subset;
+        ThreadPool pool(threads, cl.flags.count("pin") != 0);
+        if (cl.command == "batch") return run_batch_xor_pir(pool, kind, streamCfg, cl.args, cl.flag("out", "retrieved"));
+        return run_xor_pir(pool, kind, streamCfg);
+    }
 
-int main() {
     auto overall = std::chrono::steady_clock::now();
     std::cout << "[PIR] Real PIR Protocol\n";
     printDivider();
@@ -373,13 +4280,13 @@ int main() {
     std::cout << "Client wants video " << targetIndex << " (server doesn't know this)\n";
 
     auto query = client_generate_query(targetIndex, videoFiles.size());
-    auto serverResp = server_process_query(query, videoFiles);
-    if (client_reconstruct_video(serverResp, static_cast<size_t>(targetIndex))) {
+    ThreadPool pool(threads, cl.flags.count("pin") != 0);
+    if (server_process_query(query, videoFiles, streamCfg, pool, kServerResponseFile) &&
+        client_reconstruct_video(kServerResponseFile, static_cast<size_t>(targetIndex), streamCfg, pool)) {
         std::cout << "\n[DONE] PIR Protocol Completed!\n";
         std::cout << "[TIME] Total time: " << secsSince(overall) << " seconds\n";
         std::cout << "Server processed query without knowing which video was requested\n";
         std::cout << "Generated files:\n";
-        std::cout << "  - retrieved_video.bits\n";
         std::cout << "  - reconstructed_video.mp4\n";
         std::cout << "[OK] Video is ready to play!\n";
     } else {
@@ -388,5 +4295,6 @@ int main() {
 
     return 0;
 }
+#endif
 
 
@@ -0,0 +1,324 @@
+// Known-answer checks for the PIR building blocks. The test compiles the
+// protocol source itself, so it is built next to the binary with the same flags:
+//   g++ -std=c++17 -O2 -pthread real_pir_protocol_test.cpp -o real_pir_protocol_test
+// and exits non-zero if any check fails.
+#define PIR_NO_MAIN
+#if defined(__GNUC__) || defined(__clang__)
+// The commands are only reachable from the protocol's own main()
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#endif
+#include "real_pir_protocol.cpp"
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+    if (!ok) ++failures;
+    std::cout << (ok ? "[OK] " : "[ERROR] ") << what << "\n";
+}
+
+// XOR of the two parties' full-domain evaluations is the point function
+// e_alpha, for domains that are and are not powers of two
+static void testDpf(ThreadPool &pool) {
+    const size_t totals[] = {1, 2, 7, 64, 1000, 4096, 5000};
+    for (size_t total : totals) {
+        bool ok = true;
+        for (size_t alpha : {size_t(0), total / 2, total - 1}) {
+            DpfKey k0, k1;
+            dpfGenerate(alpha, dpfDepthFor(total), k0, k1);
+            DpfKey r0, r1;
+            const auto s0 = k0.serialize(), s1 = k1.serialize();
+            ok = ok && DpfKey::deserialize(s0.data(), s0.size(), r0) && DpfKey::deserialize(s1.data(), s1.size(), r1);
+            const BitVector e0 = dpfEvalFull(r0, total, pool), e1 = dpfEvalFull(r1, total, pool);
+            ok = ok && e0.size() == total && e1.size() == total;
+            for (size_t x = 0; ok && x < total; ++x) ok = (e0.get(x) != e1.get(x)) == (x == alpha);
+        }
+        check(ok, "DPF evaluates to the point function over " + std::to_string(total) + " indices");
+    }
+}
+
+// RFC 7539 section 2.3.2 block function vector; the eight-block (AVX2) path and
+// MaskPrg's seekable fill must agree with the single-block reference
+static void testChaCha20() {
+    uint32_t in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    for (int i = 0; i < 8; ++i) {
+        in[4 + i] = uint32_t(4 * i) | uint32_t(4 * i + 1) << 8 | uint32_t(4 * i + 2) << 16 | uint32_t(4 * i + 3) << 24;
+    }
+    in[12] = 0x00000001;
+    in[13] = 0x09000000;
+    in[14] = 0x4a000000;
+    in[15] = 0x00000000;
+    static const uint32_t expected[16] = {0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3, 0xc7f4d1c7, 0x0368c033,
+                                          0x9aaa2204, 0x4e6cd4c3, 0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+                                          0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2};
+    uint32_t out[16];
+    chacha20Block(in, out);
+    check(std::memcmp(out, expected, sizeof(out)) == 0, "ChaCha20 block matches the RFC 7539 test vector");
+
+    uint32_t states[16 * 9], batched[16 * 9], single[16];
+    for (size_t b = 0; b < 9; ++b) {
+        std::memcpy(states + 16 * b, in, sizeof(in));
+        states[16 * b + 12] = static_cast<uint32_t>(b);
+    }
+    chacha20Blocks(states, batched, 9);
+    bool same = true;
+    for (size_t b = 0; b < 9; ++b) {
+        chacha20Block(states + 16 * b, single);
+        same = same && std::memcmp(single, batched + 16 * b, sizeof(single)) == 0;
+    }
+    check(same, std::string("ChaCha20 batched blocks (") + simdLevelName() + ") match the reference");
+
+    MaskPrg::Seed seed;
+    for (size_t i = 0; i < seed.size(); ++i) seed[i] = static_cast<unsigned char>(i * 7 + 1);
+    const MaskPrg prg(seed, 3);
+    std::vector<uint64_t> whole(200), part(37);
+    prg.fill(whole.data(), 0, whole.size());
+    prg.fill(part.data(), 101, part.size());
+    check(std::equal(part.begin(), part.end(), whole.begin() + 101), "MaskPrg output is the same when filled from an offset");
+}
+
+// Gf2MatMul against a row-by-row XOR, for batch sizes that take the direct,
+// 4-row and 8-row table paths and row counts that leave a partial group
+static void testGf2MatMul() {
+    std::mt19937_64 rng(42);
+    const size_t n = 300, nRows = 37;
+    std::vector<std::vector<uint64_t>> data(nRows, std::vector<uint64_t>(n));
+    std::vector<const uint64_t*> rows;
+    for (auto &r : data) {
+        for (auto &w : r) w = rng();
+        rows.push_back(r.data());
+    }
+    for (size_t K : {size_t(3), size_t(20), size_t(300)}) {
+        const size_t selStride = (nRows + 7) / 8;
+        std::vector<uint8_t> sel(K * selStride);
+        for (auto &b : sel) b = static_cast<uint8_t>(rng());
+        std::vector<uint64_t> acc(K * n), expected(K * n);
+        for (size_t i = 0; i < acc.size(); ++i) acc[i] = expected[i] = rng(); // accumulates into existing contents
+        for (size_t q = 0; q < K; ++q) {
+            for (size_t r = 0; r < nRows; ++r) {
+                if ((sel[q * selStride + r / 8] >> (r % 8)) & 1) {
+                    for (size_t c = 0; c < n; ++c) expected[q * n + c] ^= data[r][c];
+                }
+            }
+        }
+        Gf2MatMul mm;
+        mm.multiply(rows.data(), nRows, n, sel.data(), K, acc.data(), n);
+        const unsigned g = Gf2MatMul::groupBits(K);
+        check(acc == expected, "Gf2MatMul matches naive XOR for K = " + std::to_string(K) + " (" +
+                                   (g ? std::to_string(g) + "-row tables)" : std::string("direct XOR)")));
+    }
+}
+
+// Packs text through TextBitPacker in pieces of `step` characters
+static std::vector<unsigned char> packText(TextBitPacker &packer, const std::string &text, size_t step) {
+    std::vector<unsigned char> out(text.size() / 8 + 16);
+    size_t at = 0;
+    for (size_t i = 0; i < text.size(); i += step) {
+        const size_t n = std::min(step, text.size() - i);
+        at += packer.pack(text.data() + i, n, out.data() + at);
+    }
+    at += packer.finish(out.data() + at);
+    out.resize(at);
+    return out;
+}
+
+// TextBitPacker against a character-by-character packer, and rejection of a
+// stray character both in a short tail and inside a full 64-character block
+static void testTextBitPacker() {
+    std::mt19937_64 rng(7);
+    std::string text;
+    std::vector<unsigned char> expected;
+    size_t bits = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        const uint64_t r = rng();
+        if (r % 9 == 0) {
+            text += " \t\r\n"[r / 9 % 4];
+            continue;
+        }
+        const bool bit = r >> 40 & 1;
+        text += bit ? '1' : '0';
+        if (bits % 8 == 0) expected.push_back(0);
+        if (bit) expected.back() |= static_cast<unsigned char>(0x80 >> (bits % 8));
+        ++bits;
+    }
+    bool ok = true;
+    for (size_t step : {size_t(1000), size_t(64), size_t(13)}) {
+        TextBitPacker packer;
+        ok = ok && packText(packer, text, step) == expected && packer.bitLength() == bits && !packer.failed();
+    }
+    check(ok, "TextBitPacker matches a naive packer across whitespace and split calls");
+
+    TextBitPacker shortTail;
+    const std::vector<unsigned char> head = packText(shortTail, "0101 10x1", 9);
+    check(shortTail.failed() && shortTail.errorOffset() == 7 && shortTail.errorChar() == 'x' &&
+              shortTail.bitLength() == 6 && head == std::vector<unsigned char>{0x58},
+          "TextBitPacker rejects a stray character and keeps the bits before it");
+
+    std::string block(200, '1');
+    block[100] = '2';
+    TextBitPacker inBlock;
+    packText(inBlock, block, block.size());
+    check(inBlock.failed() && inBlock.errorOffset() == 100 && inBlock.errorChar() == '2' && inBlock.bitLength() == 100,
+          "TextBitPacker rejects a stray character inside a full block");
+}
+
+// Scratch folder under the system temp directory, removed with its contents
+struct TempDir {
+    fs::path path;
+
+    explicit TempDir(const std::string &name) {
+        path = fs::temp_directory_path() / ("pir_test_" + name + "_" + std::to_string(std::random_device()()));
+        fs::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+static BitVector randomBits(std::mt19937_64 &rng, size_t bits) {
+    BitVector v(bits);
+    for (size_t w = 0; w < v.wordCount(); ++w) v.words()[w] = rng();
+    v.clearTail();
+    return v;
+}
+
+// Write bits as a packed record in 1024-word pieces, so the checksum is chained
+static bool writeTestRecord(const fs::path &path, const BitVector &bits) {
+    BitStreamWriter out;
+    if (!out.open(path, BitFormat::PackedRecord)) return false;
+    for (size_t w = 0; w < bits.wordCount(); w += 1024) {
+        if (!out.write(bits.words() + w, std::min<size_t>(1024 * 64, bits.size() - w * 64))) return false;
+    }
+    return out.close();
+}
+
+// Packed records written piecewise read back bit for bit, through
+// readRecordFile and a mapped RecordView, and their header holds the checksum
+// of the whole payload
+static void testPackedRecord() {
+    TempDir dir("record");
+    std::mt19937_64 rng(11);
+    bool ok = true;
+    const size_t lengths[] = {1, 63, 64, 65, 8191, 100003};
+    for (size_t bits : lengths) {
+        const BitVector expected = randomBits(rng, bits);
+        const fs::path path = dir.path / (std::to_string(bits) + kRecordSuffix);
+        BitVector back;
+        RecordHeader hdr;
+        std::ifstream in;
+        ok = ok && writeTestRecord(path, expected) && readRecordFile(path, back) && back.size() == bits &&
+             std::memcmp(back.bytes(), expected.bytes(), expected.byteSize()) == 0;
+        in.open(path, std::ios::in | std::ios::binary);
+        ok = ok && readRecordHeader(in, hdr) && hdr.bitLength == bits &&
+             hdr.checksum == recordChecksum(expected.bytes(), expected.byteSize());
+
+        RecordView view;
+        std::vector<uint64_t> words(expected.wordCount() + 1, ~uint64_t(0));
+        ok = ok && view.open(path) && view.bitLength() == bits;
+        if (ok) view.copyWords(0, words.size(), words.data());
+        ok = ok && std::equal(expected.words(), expected.words() + expected.wordCount(), words.begin()) && words.back() == 0;
+    }
+    check(ok, "Packed records round-trip with their checksum for " + std::to_string(std::size(lengths)) + " lengths");
+}
+
+// Words [w, w + n) of bits, zero past the end
+static std::vector<uint64_t> expectedWords(const BitVector &bits, size_t w, size_t n) {
+    std::vector<uint64_t> out(n, 0);
+    for (size_t i = 0; i < n && w + i < bits.wordCount(); ++i) out[i] = bits.words()[w + i];
+    return out;
+}
+
+// A v2 container built from records of different lengths (one tile exactly,
+// several tiles with a partial last one, and shorter than a tile) serves each
+// record's words unchanged: the whole record plus padding, and a window that
+// crosses a tile boundary, read through the mapping and with direct reads
+static void testContainer() {
+    TempDir dir("container");
+    std::mt19937_64 rng(13);
+    const size_t tileBits = kContainerTile * 8;
+    const size_t lengths[] = {100, 3 * tileBits + 805, tileBits, 2 * tileBits + 1};
+    std::vector<BitVector> records;
+    bool ok = true;
+    for (size_t i = 0; i < std::size(lengths); ++i) {
+        records.push_back(randomBits(rng, lengths[i]));
+        ok = ok && writeTestRecord(dir.path / (std::string(1, char('a' + i)) + ".mp4" + kRecordSuffix), records.back());
+    }
+    Catalog catalog;
+    std::vector<Container> containers;
+    std::vector<size_t> ids(records.size());
+    for (size_t i = 0; i < ids.size(); ++i) ids[i] = i;
+    ok = ok && buildCatalog(dir.path) && catalog.open(dir.path) && catalog.size() == records.size() &&
+         buildContainer(containerPath(dir.path, 0, 1), catalog, ids, 0, 1) &&
+         openCurrentContainers(dir.path, catalog, containers) && containers.size() == 1;
+    check(ok, "Container built from " + std::to_string(records.size()) + " records opens as current");
+    if (!ok) return;
+
+    const Container &c = containers.front();
+    const size_t window = kContainerTile / 8 - 3; // starts 3 words before the first tile boundary
+    bool mapped = c.stride() == 4 * kContainerTile;
+    for (size_t i = 0; mapped && i < records.size(); ++i) {
+        const RecordView view = c.view(i);
+        const size_t n = records[i].wordCount() + 1;
+        std::vector<uint64_t> all(n), staging;
+        view.copyWords(0, n, all.data());
+        const uint64_t *part = view.words(window, 6, staging);
+        mapped = c.entry(i).id == i && view.bitLength() == lengths[i] && all == expectedWords(records[i], 0, n) &&
+                 std::equal(part, part + 6, expectedWords(records[i], window, 6).begin());
+    }
+    check(mapped, "Container records read back through the mapping, across tile boundaries");
+
+#ifndef _WIN32
+    for (IoBackend backend : {IoBackend::Pread, IoBackend::Uring}) {
+        std::unique_ptr<BlockReader> reader = makeBlockReader(backend, 8);
+        RecordFetcher fetcher(*reader);
+        std::vector<RecordView> views;
+        std::vector<std::vector<uint64_t>> all(records.size()), part(records.size());
+        bool direct = true;
+        for (size_t i = 0; i < records.size(); ++i) {
+            views.push_back(c.view(i));
+            direct = direct && views.back().enableDirectReads();
+        }
+        for (size_t i = 0; direct && i < records.size(); ++i) {
+            all[i].assign(records[i].wordCount() + 1, ~uint64_t(0));
+            part[i].assign(6, ~uint64_t(0));
+            views[i].fetchWords(fetcher, 0, all[i].size(), all[i].data());
+            views[i].fetchWords(fetcher, window, 6, part[i].data());
+        }
+        direct = direct && fetcher.run();
+        for (size_t i = 0; direct && i < records.size(); ++i) {
+            direct = all[i] == expectedWords(records[i], 0, all[i].size()) && part[i] == expectedWords(records[i], window, 6);
+        }
+        check(direct, std::string("Container records read back with ") + reader->name() + " direct reads");
+    }
+#endif
+}
+
+// Size classes of bucketed packing at their limits: 1 MB, then `ratio` times
+// the previous limit, with each limit itself still in the lower class; huge
+// lengths stay in the top class instead of overflowing the limit
+static void testSizeClass() {
+    const uint64_t mb = kBucketBaseBytes * 8; // in bits
+    const bool ok = sizeClass(0, 2) == 0 && sizeClass(1, 2) == 0 && sizeClass(mb, 2) == 0 && sizeClass(mb + 1, 2) == 1 &&
+                    sizeClass(2 * mb, 2) == 1 && sizeClass(2 * mb + 1, 2) == 2 && sizeClass(4 * mb, 4) == 1 &&
+                    sizeClass(4 * mb + 8, 4) == 2 && sizeClass(16 * mb, 4) == 2 && sizeClass(1024 * mb, 1024) == 1 &&
+                    sizeClass(1024 * mb + 1, 1024) == 2 && sizeClass(UINT64_MAX / 2, 2) == 40 && sizeClass(UINT64_MAX / 2, 1000) == 4;
+    check(ok, "sizeClass puts each limit in the lower class and the next byte in the next one");
+}
+
+int main() {
+    ThreadPool pool(2, false);
+    testDpf(pool);
+    testChaCha20();
+    testGf2MatMul();
+    testTextBitPacker();
+    testPackedRecord();
+    testContainer();
+    testSizeClass();
+    if (failures) std::cout << "[ERROR] " << failures << " check(s) failed\n";
+    return failures ? 1 : 0;
+}